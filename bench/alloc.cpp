@@ -0,0 +1,123 @@
+/**
+ * Check that updating a stroke stays off the heap, the way RecognitionStage does it for the demo.
+ *
+ *		alloc [--rounds n] [--warmup n] [--strokes n] [--threads n] gesture_file
+ *
+ * Built with OCTOPOCUS_COUNT_ALLOCATIONS, @see AllocCheck. Each stroke retraces one of the templates of gesture_file
+ * on a stroke reserved the way the demo does: Begin, then --warmup rounds that may allocate as buffers grow, then
+ * --rounds rounds of adding a point, Recognizer::Update and FeedForward::Present that must not. Strokes are run on the
+ * calling thread alone, then with a WorkerPool of --threads (0 for one per cpu), whose threads are not counted.
+ * Exits with 1 and tells which stroke allocated how many times otherwise, in release builds as well.
+ */
+#include "alloc_check.h"
+#include "feedback.h"
+#include "feedforward.h"
+#include "gesture.h"
+#include "gesture_manager.h"
+#include "gesture_snapshot.h"
+#include "recognizer.h"
+#include "worker_pool.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <string>
+#include <vector>
+
+#ifndef OCTOPOCUS_COUNT_ALLOCATIONS
+	#error alloc counts allocations, build it with OCTOPOCUS_COUNT_ALLOCATIONS.
+#endif
+
+static const int kStrokeId = 1;
+
+//Allocations of the rounds after warm-up of stroke retracing g.
+static unsigned long Run(const Gesture &g, const GestureSnapshot &snapshot, WorkerPool *pool, int warmup, int rounds) {
+	const GestureSnapshot::Templates &templates = snapshot.GetTemplates();
+	//Points of the whole stroke up front, placed elsewhere than the template.
+	int count = 1+warmup+rounds;
+	std::vector<Gesture::Point> points;
+	g.UniformSample(count, &points);
+
+	Gesture stroke;
+	stroke.Reserve(Gesture::kStrokeReserve);
+	stroke.SetSimplify(Gesture::kStrokeSimplify);
+	Recognizer recognizer;
+	recognizer.SetPool(pool);
+	FeedForward feedforward;
+	Feedback feedback;
+	feedback.items.reserve(FeedForward::kMaxCandidates);
+	feedback.labels.reserve(FeedForward::kMaxCandidates);
+
+	stroke.PushBack(points[0].x+100.0f, points[0].y+100.0f);
+	recognizer.Begin(&stroke, templates);
+	feedforward.Begin();
+	feedforward.Present(recognizer, stroke, kStrokeId, templates, &feedback);
+	unsigned long start = 0;
+	for(int i=1; i<count; i++) {
+		if(i == 1+warmup)
+			start = AllocCheck::Count();
+		stroke.PushBack(points[i].x+100.0f, points[i].y+100.0f);
+		recognizer.Update();
+		feedforward.Present(recognizer, stroke, kStrokeId, templates, &feedback);
+	}
+	unsigned long allocations = AllocCheck::Count()-start;
+	recognizer.End();
+	return allocations;
+}
+
+int main(int argc, char **argv) {
+	int rounds = 256, warmup = 16, strokes = 16, threads = 0;
+	std::vector<std::string> files;
+	for(int i=1; i<argc; i++) {
+		std::string arg = argv[i];
+		if(arg == "--rounds" && i+1 < argc)
+			rounds = atoi(argv[++i]);
+		else if(arg == "--warmup" && i+1 < argc)
+			warmup = atoi(argv[++i]);
+		else if(arg == "--strokes" && i+1 < argc)
+			strokes = atoi(argv[++i]);
+		else if(arg == "--threads" && i+1 < argc)
+			threads = atoi(argv[++i]);
+		else
+			files.push_back(arg);
+	}
+	if(files.size() != 1 || rounds < 1 || warmup < 0 || strokes < 1 || 1+warmup+rounds > Gesture::kStrokeReserve) {
+		fprintf(stderr, "Usage: %s [--rounds n] [--warmup n] [--strokes n] [--threads n] gesture_file\n"
+			"1+warmup+rounds should not be more than %d.\n", argv[0], (int)Gesture::kStrokeReserve);
+		return 1;
+	}
+	const std::string &file = files[0];
+
+	GestureManager manager;
+	manager.SetSimplify(Gesture::kStrokeSimplify.distance);
+	if(!manager.Load(file)) {
+		fprintf(stderr, "%s: %s.\n", file.c_str(), manager.GetError().c_str());
+		return 1;
+	}
+	const GestureSnapshot *snapshot = manager.GetSnapshot();
+	const GestureSnapshot::Templates &templates = snapshot->GetTemplates();
+	if(templates.empty()) {
+		fprintf(stderr, "%s: no gestures.\n", file.c_str());
+		snapshot->Release();
+		return 1;
+	}
+
+	WorkerPool pool(threads);
+	int failed = 0;
+	for(int p=0; p<2; p++) {
+		WorkerPool *used = p ? &pool : 0;
+		for(int i=0; i<strokes; i++) {
+			const std::pair<std::string, const Gesture *> &t = templates[i*templates.size()/strokes];
+			unsigned long allocations = Run(*t.second, *snapshot, used, warmup, rounds);
+			if(allocations) {
+				fprintf(stderr, "%s%s: %lu allocations in %d rounds after warm-up.\n",
+					t.first.c_str(), used ? " (pool)" : "", allocations, rounds);
+				failed++;
+			}
+		}
+	}
+	snapshot->Release();
+
+	printf("%d of %d strokes allocated after %d warm-up rounds, %d rounds each.\n", failed, 2*strokes, warmup, rounds);
+	return failed ? 1 : 0;
+}
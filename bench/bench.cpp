@@ -0,0 +1,342 @@
+/**
+ * Benchmarks of the geometry and recognition hot paths, on synthetic gestures, @see synthetic.h.
+ *
+ *		bench [--quick] [--filter name] [--min-time seconds] [--threads n] [--revision id] [--out file] [--tmp dir]
+ *
+ * Per stroke operations are swept from 10 to 1M points, library operations from 5 to 100k templates of
+ * kTemplatePoints points each. --quick stops at 10k points and 1k templates.
+ * Results go to stdout or --out as one JSON document, one entry per benchmark and size, so that runs of different
+ * commits can be compared by a script. Progress goes to stderr.
+ */
+#include "synthetic.h"
+#include "gesture.h"
+#include "gesture_manager.h"
+#include "recognizer.h"
+#include "simplify.h"
+#include "worker_pool.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <string>
+#include <vector>
+
+static const int kPoints[] = {10, 100, 1000, 10000, 100000, 1000000};
+static const int kTemplates[] = {5, 100, 1000, 10000, 100000};
+static const int kQuickPoints = 10000;
+static const int kQuickTemplates = 1000;
+static const int kTemplatePoints = 64;
+static const float kSize = 200.0f;				//Pixels across a gesture.
+static const float kNoise = 3.0f;				//Pixels a query point is off its template.
+static const int kRanked = 5;					//Candidates ranked per update, as many as the demo shows.
+
+//Keeps results alive so the compiler can't drop the work.
+static volatile float sink;
+
+struct Options {
+	bool quick;
+	std::string filter;
+	double min_time;
+	int threads;
+	std::string revision;
+	std::string out;
+	std::string tmp;
+
+	Options() : quick(false), min_time(0.2), threads(1), tmp("/tmp") {}
+};
+
+class Suite {
+public:
+	struct Result {
+		std::string name;
+		int points;			//Per stroke, 0 if not relevant. So is templates.
+		int templates;
+		long long iterations;
+		double ns_per_op;
+	};
+
+public:
+	Suite(const Options &_options) : options(_options) {}
+
+	bool Enabled(const char *name) const {
+		return options.filter.empty() || strstr(name, options.filter.c_str());
+	}
+
+	//Time op, called with no argument, growing the iterations until they take min_time at least.
+	template<class Op>
+	void Measure(const char *name, int points, int templates, Op op) {
+		if(!Enabled(name))
+			return;
+		long long iterations = 1;
+		double elapsed = 0.0;
+		for(;;) {
+			double start = Now();
+			for(long long i=0; i<iterations; i++) {
+				op();
+			}
+			elapsed = Now()-start;
+			if(elapsed >= options.min_time || iterations >= (1LL<<40))
+				break;
+			//Aim a bit past min_time, but never grow by more than 10x on a noisy first guess.
+			double factor = elapsed > 0.0 ? options.min_time/elapsed*1.2 : 10.0;
+			factor = factor < 2.0 ? 2.0 : (factor > 10.0 ? 10.0 : factor);
+			iterations = (long long)(iterations*factor);
+		}
+
+		Result r;
+		r.name = name;
+		r.points = points;
+		r.templates = templates;
+		r.iterations = iterations;
+		r.ns_per_op = elapsed/iterations*1e9;
+		results.push_back(r);
+		fprintf(stderr, "%-20s points %8d templates %7d  %14.1f ns/op  (%lld iterations)\n",
+			name, points, templates, r.ns_per_op, iterations);
+	}
+
+	void Write(FILE *file) const {
+		fprintf(file, "{\n");
+		fprintf(file, "\t\"suite\": \"octopocus_demo\",\n");
+		fprintf(file, "\t\"revision\": \"%s\",\n", options.revision.c_str());
+		fprintf(file, "\t\"threads\": %d,\n", options.threads);
+		fprintf(file, "\t\"min_time\": %g,\n", options.min_time);
+		fprintf(file, "\t\"results\": [\n");
+		for(int i=0; i<results.size(); i++) {
+			const Result &r = results[i];
+			fprintf(file, "\t\t{\"name\": \"%s\", \"points\": %d, \"templates\": %d, \"iterations\": %lld, \"ns_per_op\": %.3f}%s\n",
+				r.name.c_str(), r.points, r.templates, r.iterations, r.ns_per_op, i+1 < results.size() ? "," : "");
+		}
+		fprintf(file, "\t]\n}\n");
+	}
+
+	static double Now() {
+		timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		return ts.tv_sec + ts.tv_nsec*1e-9;
+	}
+
+private:
+	const Options &options;
+	std::vector<Result> results;
+};
+
+/****************Per stroke.****************/
+static void BenchStroke(Suite &suite, int n) {
+	std::vector<float> xs, ys;
+	synthetic::Stroke(1, n, kSize, &xs, &ys);
+
+	//Arc length parameterization of every point, which Append computes on the way.
+	suite.Measure("parameterization", n, 0, [&]() {
+		Gesture g;
+		g.Append(&xs[0], &ys[0], n);
+		sink = g.Length();
+	});
+
+	Gesture *stroke = synthetic::MakeStroke(1, n, kSize);
+	int step = 0;
+	suite.Measure("sample", n, 0, [&]() {
+		//Spread over the whole stroke, so that the search does not always take the same path.
+		step = (step+7919) % 10007;
+		sink = stroke->Sample(step/10007.0f).x;
+	});
+
+	float out_x[Gesture::kMaxSampleSize], out_y[Gesture::kMaxSampleSize];
+	suite.Measure("uniform_sample", n, 0, [&]() {
+		stroke->UniformSample(Gesture::kMaxSampleSize, out_x, out_y);
+		sink = out_x[Gesture::kMaxSampleSize-1];
+	});
+
+	suite.Measure("build_descriptor", n, 0, [&]() {
+		Gesture::Descriptor d;
+		stroke->BuildDescriptor(&d);
+		sink = d.length;
+		stroke->SetDescriptor(0);
+	});
+
+	Gesture *query = synthetic::MakeQuery(1, n, kSize, kNoise);
+	suite.Measure("compare", n, 0, [&]() {
+		sink = query->Compare(*stroke);
+	});
+
+	stroke->BuildDescriptor();
+	suite.Measure("compare_descriptor", n, 0, [&]() {
+		sink = query->Compare(*stroke);
+	});
+
+	//Simplification, of the noisy query as drawn strokes come with noise. What it costs in accuracy goes to stderr.
+	std::vector<float> query_xs(n), query_ys(n);
+	for(int i=0; i<n; i++) {
+		Gesture::Point p = query->Get(i);
+		query_xs[i] = p.x;
+		query_ys[i] = p.y;
+	}
+	Gesture online;
+	suite.Measure("simplify_online", n, 0, [&]() {
+		online = Gesture();
+		online.Reserve(n);
+		online.SetSimplify(Gesture::kStrokeSimplify);
+		for(int i=0; i<n; i++) {
+			online.PushBack(query_xs[i], query_ys[i]);
+		}
+		sink = online.Length();
+	});
+
+	std::vector<float> rdp_xs, rdp_ys;
+	int rdp_size = 0;
+	suite.Measure("simplify_rdp", n, 0, [&]() {
+		rdp_xs = query_xs;
+		rdp_ys = query_ys;
+		rdp_size = simplify::Rdp(&rdp_xs[0], &rdp_ys[0], n, Gesture::kStrokeSimplify.distance);
+		sink = rdp_xs[rdp_size-1];
+	});
+	Gesture rdp;
+	rdp.Append(&rdp_xs[0], &rdp_ys[0], rdp_size);
+	float error = query->Compare(*stroke);
+	fprintf(stderr, "simplify %d points: online keeps %d, error %+.4f; rdp keeps %d, error %+.4f; length %+.3f%%\n",
+		query->Size(), online.Size(), online.Compare(*stroke)-error, rdp.Size(), rdp.Compare(*stroke)-error,
+		(online.Length()/query->Length()-1)*100);
+
+	delete query;
+	delete stroke;
+}
+
+/****************Per library.****************/
+static void BenchLibrary(Suite &suite, const Options &options, WorkerPool *pool, int count) {
+	std::vector<std::pair<std::string, Gesture *> > templates;
+	synthetic::MakeTemplates(count, kTemplatePoints, kSize, &templates);
+
+	//Load and Save, through the manager like the demo does.
+	{
+		GestureManager manager;
+		for(int i=0; i<templates.size(); i++) {
+			manager.Put(templates[i].first, new Gesture(*templates[i].second));
+		}
+		std::string text = options.tmp + "/octopocus_bench.dat", library = options.tmp + "/octopocus_bench.gbin";
+		//Loading is timed on its own, whether saving is or not.
+		manager.Save(text, GestureManager::TEXT);
+		manager.Save(library, GestureManager::LIBRARY);
+		suite.Measure("save_text", kTemplatePoints, count, [&]() {
+			manager.Save(text, GestureManager::TEXT);
+		});
+		suite.Measure("save_library", kTemplatePoints, count, [&]() {
+			manager.Save(library, GestureManager::LIBRARY);
+		});
+		//A fresh manager each time, loading adds to what is there.
+		suite.Measure("load_text", kTemplatePoints, count, [&]() {
+			GestureManager m;
+			m.Load(text, pool);
+			sink = (float)m.Size();
+		});
+		suite.Measure("load_library", kTemplatePoints, count, [&]() {
+			GestureManager m;
+			m.Load(library, pool);
+			sink = (float)m.Size();
+		});
+		suite.Measure("open_lazy", kTemplatePoints, count, [&]() {
+			GestureManager m;
+			m.Open(text);
+			sink = (float)m.OpenedSize();
+		});
+		remove(text.c_str());
+		remove(library.c_str());
+	}
+
+	//What a snapshot of the manager hands out.
+	Recognizer::Gestures shared(templates.begin(), templates.end());
+	Recognizer recognizer;
+	recognizer.SetPool(pool);
+	Gesture *query = synthetic::MakeQuery(count/2, kTemplatePoints, kSize, kNoise);
+	suite.Measure("best_match", kTemplatePoints, count, [&]() {
+		float falloff;
+		sink = (float)recognizer.BestMatch(query, shared, &falloff);
+	});
+
+	GestureIndex index;
+	if(suite.Enabled("best_match_index"))
+		index.Build(shared);
+	suite.Measure("best_match_index", kTemplatePoints, count, [&]() {
+		float falloff;
+		sink = (float)recognizer.BestMatch(query, index, &falloff);
+	});
+
+	//Falloff of every template while the stroke is drawn point by point, what the demo does on each mouse move.
+	std::vector<float> xs, ys;
+	synthetic::Stroke(count/2, kTemplatePoints, kSize, &xs, &ys);
+	std::vector<int> ranked;
+	suite.Measure("stroke_falloff", kTemplatePoints, count, [&]() {
+		Gesture stroke;
+		stroke.PushBack(xs[0], ys[0]);
+		recognizer.Begin(&stroke, shared);
+		for(int i=1; i<kTemplatePoints; i++) {
+			stroke.PushBack(xs[i], ys[i]);
+			recognizer.Update();
+			recognizer.Rank(kRanked, &ranked);
+			for(int k=0; k<ranked.size(); k++) {
+				sink = recognizer.Falloff(ranked[k]);
+			}
+		}
+		recognizer.End();
+	});
+
+	delete query;
+	synthetic::Free(&templates);
+}
+
+static bool ParseOptions(int argc, char **argv, Options *options) {
+	for(int i=1; i<argc; i++) {
+		std::string arg = argv[i];
+		bool has_value = i+1 < argc;
+		if(arg == "--quick")
+			options->quick = true;
+		else if(arg == "--filter" && has_value)
+			options->filter = argv[++i];
+		else if(arg == "--min-time" && has_value)
+			options->min_time = atof(argv[++i]);
+		else if(arg == "--threads" && has_value)
+			options->threads = atoi(argv[++i]);
+		else if(arg == "--revision" && has_value)
+			options->revision = argv[++i];
+		else if(arg == "--out" && has_value)
+			options->out = argv[++i];
+		else if(arg == "--tmp" && has_value)
+			options->tmp = argv[++i];
+		else
+			return false;
+	}
+	return true;
+}
+
+int main(int argc, char **argv) {
+	Options options;
+	if(!ParseOptions(argc, argv, &options)) {
+		fprintf(stderr, "Usage: %s [--quick] [--filter name] [--min-time seconds] [--threads n] [--revision id] "
+			"[--out file] [--tmp dir]\n", argv[0]);
+		return 1;
+	}
+	//1 thread runs everything on the calling thread, the way the numbers are most stable.
+	WorkerPool *pool = options.threads != 1 ? new WorkerPool(options.threads) : 0;
+	Suite suite(options);
+	for(int i=0; i<sizeof(kPoints)/sizeof(kPoints[0]); i++) {
+		if(options.quick && kPoints[i] > kQuickPoints)
+			break;
+		BenchStroke(suite, kPoints[i]);
+	}
+	for(int i=0; i<sizeof(kTemplates)/sizeof(kTemplates[0]); i++) {
+		if(options.quick && kTemplates[i] > kQuickTemplates)
+			break;
+		BenchLibrary(suite, options, pool, kTemplates[i]);
+	}
+	delete pool;
+
+	FILE *file = options.out.empty() ? stdout : fopen(options.out.c_str(), "w");
+	if(!file) {
+		fprintf(stderr, "Cannot write %s.\n", options.out.c_str());
+		return 1;
+	}
+	suite.Write(file);
+	if(file != stdout)
+		fclose(file);
+	return 0;
+}
@@ -0,0 +1,313 @@
+/**
+ * Headless replay of stroke traces recorded by the demo, @see StrokeTrace.
+ *
+ *		replay [--fast] [--threads n] [--out file] gesture_file trace...
+ *
+ * Strokes go through the same StrokeController and RecognitionStage as in the demo, only without a window. Events are
+ * paced the way they were recorded, or sent as fast as possible with --fast. Reported, as JSON on stdout or --out
+ * and as a summary on stderr:
+ *		update latency, from an update to the first feedback covering it, percentiles over every update
+ *		result latency, from completing a stroke to its match
+ *		the match of every stroke, and how many differ from the results recorded in the trace
+ */
+#include "gesture.h"
+#include "gesture_manager.h"
+#include "stroke_controller.h"
+#include "stroke_trace.h"
+#include "worker_pool.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <algorithm>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include <wx/init.h>
+#include <wx/event.h>
+#include <wx/utils.h>
+
+static const int kRecognitionId = 1;
+static const double kResultTimeout = 10.0;		//Seconds to wait for the results of a trace once it is over.
+
+static double Now() {
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+class Replayer : public wxEvtHandler {
+public:
+	//What became of a stroke.
+	struct Stroke {
+		std::string trace;
+		int index;					//In the trace.
+		bool cancelled;
+		bool matched;				//A result came back.
+		std::string result;			//Empty if nothing matches.
+		bool has_expected;			//The trace holds the result of the recording.
+		bool expected_cancelled;
+		std::string expected;
+
+		Stroke() : index(0), cancelled(false), matched(false), has_expected(false), expected_cancelled(false) {}
+	};
+
+	std::vector<Stroke> strokes;
+	std::vector<double> update_latency, result_latency;		//Seconds.
+	int dropped_updates;			//Never covered by feedback before the stroke was complete.
+
+public:
+	Replayer(GestureManager *manager, WorkerPool *pool)
+				: dropped_updates(0), stage(this, kRecognitionId, pool), controller(&stage, manager) {
+		Bind(wxEVT_THREAD, &Replayer::OnRecognition, this, kRecognitionId);
+	}
+
+	void Run(const std::string &name, const StrokeTrace &trace, bool fast) {
+		const std::vector<StrokeTrace::Event> &events = trace.GetEvents();
+		Gesture *stroke = 0;
+		int count = 0;
+		double start = Now();
+		for(int i=0; i<events.size(); i++) {
+			const StrokeTrace::Event &e = events[i];
+			if(!fast) {
+				while(Now()-start < e.time*1e-6) {
+					ProcessPendingEvents();
+					wxMicroSleep(100);
+				}
+			}
+			ProcessPendingEvents();
+
+			switch(e.type) {
+			case StrokeTrace::DOWN:
+				delete stroke;
+				stroke = new Gesture;
+				stroke->Reserve(Gesture::kStrokeReserve);
+				stroke->SetSimplify(Gesture::kStrokeSimplify);
+				stroke->PushBack(e.x, e.y);
+				updates.clear();
+				strokes.push_back(Stroke());
+				strokes.back().trace = name;
+				strokes.back().index = count++;
+				controller.Begin(stroke);
+				break;
+			case StrokeTrace::MOVE:
+				if(!stroke)
+					break;
+				stroke->PushBack(e.x, e.y);
+				//Moves recorded at the same time came with one update, e.g. of a frame.
+				if(i+1 < events.size() && events[i+1].type == StrokeTrace::MOVE && events[i+1].time == e.time)
+					break;
+				updates.push_back(Update(stroke->Size(), Now()));
+				controller.Update(stroke);
+				break;
+			case StrokeTrace::UP:
+				if(!stroke)
+					break;
+				dropped_updates += updates.size();
+				updates.clear();
+				if(controller.Complete(stroke))
+					completions.push_back(Completion(strokes.size()-1, Now()));
+				else
+					strokes.back().cancelled = true;
+				delete stroke;
+				stroke = 0;
+				break;
+			case StrokeTrace::RESULT:
+			case StrokeTrace::CANCEL:
+				if(strokes.empty())
+					break;
+				strokes.back().has_expected = true;
+				strokes.back().expected_cancelled = e.type == StrokeTrace::CANCEL;
+				strokes.back().expected = e.name;
+				break;
+			}
+		}
+		delete stroke;
+
+		double deadline = Now()+kResultTimeout;
+		while(!completions.empty() && Now() < deadline) {
+			ProcessPendingEvents();
+			wxMicroSleep(100);
+		}
+		if(!completions.empty()) {
+			fprintf(stderr, "%s: %d results did not come back.\n", name.c_str(), (int)completions.size());
+			completions.clear();
+		}
+	}
+
+private:
+	struct Update {
+		int points;
+		double time;
+
+		Update(int _points, double _time) : points(_points), time(_time) {}
+	};
+
+	struct Completion {
+		int stroke;
+		double time;
+
+		Completion(int _stroke, double _time) : stroke(_stroke), time(_time) {}
+	};
+
+	//The same as MainFrame::OnRecognition, minus the drawing.
+	void OnRecognition(wxThreadEvent &event) {
+		double now = Now();
+		const Feedback *feedback = controller.AcquireFeedback();
+		while(feedback && !updates.empty() && updates.front().points <= feedback->points) {
+			update_latency.push_back(now-updates.front().time);
+			updates.pop_front();
+		}
+
+		RecognitionStage::Result result;
+		while(controller.TakeResult(&result)) {
+			if(completions.empty())
+				continue;
+			//Completions are queued and never dropped, so results come back in order.
+			Stroke &s = strokes[completions.front().stroke];
+			result_latency.push_back(now-completions.front().time);
+			completions.pop_front();
+			s.matched = true;
+			s.result = result.match == -1 ? "" : result.name;
+		}
+	}
+
+private:
+	RecognitionStage stage;
+	StrokeController controller;
+	std::deque<Update> updates;				//Of the stroke being drawn, waiting for feedback.
+	std::deque<Completion> completions;		//Waiting for results.
+};
+
+static std::string Escape(const std::string &s) {
+	std::string result;
+	for(int i=0; i<s.size(); i++) {
+		char c = s[i];
+		if(c == '"' || c == '\\') {
+			result += '\\';
+			result += c;
+		}
+		else if((unsigned char)c < 0x20) {
+			char buf[8];
+			sprintf(buf, "\\u%04x", c);
+			result += buf;
+		}
+		else {
+			result += c;
+		}
+	}
+	return result;
+}
+
+//Percentiles in microseconds, nearest rank.
+static void WriteLatency(FILE *file, const char *name, std::vector<double> latency) {
+	std::sort(latency.begin(), latency.end());
+	fprintf(file, "\t\"%s\": {\"count\": %d", name, (int)latency.size());
+	static const double kPercentiles[] = {50, 90, 99, 99.9};
+	static const char *kNames[] = {"p50", "p90", "p99", "p999"};
+	for(int i=0; i<sizeof(kPercentiles)/sizeof(kPercentiles[0]); i++) {
+		double v = latency.empty() ? 0.0 : latency[(int)((latency.size()-1)*kPercentiles[i]/100.0 + 0.5)];
+		fprintf(file, ", \"%s\": %.1f", kNames[i], v*1e6);
+	}
+	fprintf(file, ", \"max\": %.1f},\n", latency.empty() ? 0.0 : latency.back()*1e6);
+	if(!latency.empty()) {
+		fprintf(stderr, "%s: %d, p50 %.0f us, p99 %.0f us, max %.0f us\n", name, (int)latency.size(),
+			latency[(latency.size()-1)/2]*1e6, latency[(int)((latency.size()-1)*0.99 + 0.5)]*1e6, latency.back()*1e6);
+	}
+}
+
+static void Write(FILE *file, const Replayer &replayer) {
+	int cancelled = 0, compared = 0, mismatches = 0;
+	for(int i=0; i<replayer.strokes.size(); i++) {
+		const Replayer::Stroke &s = replayer.strokes[i];
+		cancelled += s.cancelled;
+		if(s.has_expected) {
+			compared++;
+			mismatches += s.cancelled != s.expected_cancelled || s.result != s.expected;
+		}
+	}
+
+	fprintf(file, "{\n");
+	fprintf(file, "\t\"strokes\": %d,\n", (int)replayer.strokes.size());
+	fprintf(file, "\t\"cancelled\": %d,\n", cancelled);
+	fprintf(file, "\t\"compared\": %d,\n", compared);
+	fprintf(file, "\t\"mismatches\": %d,\n", mismatches);
+	fprintf(file, "\t\"dropped_updates\": %d,\n", replayer.dropped_updates);
+	WriteLatency(file, "update_latency_us", replayer.update_latency);
+	WriteLatency(file, "result_latency_us", replayer.result_latency);
+	fprintf(file, "\t\"results\": [\n");
+	for(int i=0; i<replayer.strokes.size(); i++) {
+		const Replayer::Stroke &s = replayer.strokes[i];
+		fprintf(file, "\t\t{\"trace\": \"%s\", \"stroke\": %d, ", Escape(s.trace).c_str(), s.index);
+		if(s.cancelled)
+			fprintf(file, "\"result\": \"cancel\"");
+		else if(s.matched)
+			fprintf(file, "\"result\": \"%s\"", Escape(s.result).c_str());
+		else
+			fprintf(file, "\"result\": null");
+		if(s.has_expected)
+			fprintf(file, ", \"expected\": \"%s\"", s.expected_cancelled ? "cancel" : Escape(s.expected).c_str());
+		fprintf(file, "}%s\n", i+1 < replayer.strokes.size() ? "," : "");
+	}
+	fprintf(file, "\t]\n}\n");
+	fprintf(stderr, "%d strokes, %d cancelled, %d of %d recorded results differ.\n",
+		(int)replayer.strokes.size(), cancelled, mismatches, compared);
+}
+
+int main(int argc, char **argv) {
+	bool fast = false;
+	int threads = 0;
+	std::string out;
+	std::vector<std::string> files;
+	for(int i=1; i<argc; i++) {
+		std::string arg = argv[i];
+		if(arg == "--fast")
+			fast = true;
+		else if(arg == "--threads" && i+1 < argc)
+			threads = atoi(argv[++i]);
+		else if(arg == "--out" && i+1 < argc)
+			out = argv[++i];
+		else
+			files.push_back(arg);
+	}
+	if(files.size() < 2) {
+		fprintf(stderr, "Usage: %s [--fast] [--threads n] [--out file] gesture_file trace...\n", argv[0]);
+		return 1;
+	}
+	wxInitializer initializer;
+	if(!initializer.IsOk()) {
+		fprintf(stderr, "Cannot initialize wxWidgets.\n");
+		return 1;
+	}
+
+	//Same threading as the demo, 0 for one per cpu.
+	WorkerPool pool(threads);
+	GestureManager manager;
+	manager.SetSimplify(Gesture::kStrokeSimplify.distance);
+	if(!manager.Load(files[0], &pool)) {
+		fprintf(stderr, "%s: %s.\n", files[0].c_str(), manager.GetError().c_str());
+		return 1;
+	}
+
+	Replayer replayer(&manager, &pool);
+	for(int i=1; i<files.size(); i++) {
+		StrokeTrace trace;
+		if(!trace.Load(files[i])) {
+			fprintf(stderr, "%s: %s.\n", files[i].c_str(), trace.GetError().c_str());
+			return 1;
+		}
+		replayer.Run(files[i], trace, fast);
+	}
+
+	FILE *file = out.empty() ? stdout : fopen(out.c_str(), "w");
+	if(!file) {
+		fprintf(stderr, "Cannot write %s.\n", out.c_str());
+		return 1;
+	}
+	Write(file, replayer);
+	if(file != stdout)
+		fclose(file);
+	return 0;
+}
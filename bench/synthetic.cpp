@@ -0,0 +1,88 @@
+#include "synthetic.h"
+#include "gesture.h"
+
+#include <math.h>
+#include <stdio.h>
+
+namespace synthetic {
+
+static const int kHarmonics = 3;
+static const float kPi = 3.14159265f;
+
+unsigned int Random::Next() {
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return state;
+}
+
+float Random::Uniform(float low, float high) {
+	return low + (high-low)*(Next() >> 8)/(float)(1 << 24);
+}
+
+void Stroke(unsigned int seed, int n, float size, std::vector<float> *xs, std::vector<float> *ys) {
+	Random random(seed);
+	float ax[kHarmonics], ay[kHarmonics], phase_x[kHarmonics], phase_y[kHarmonics];
+	for(int k=0; k<kHarmonics; k++) {
+		//Higher harmonics get smaller, like the wiggles of a hand drawn shape.
+		ax[k] = random.Uniform(-0.5f, 0.5f)*size/(k+1);
+		ay[k] = random.Uniform(-0.5f, 0.5f)*size/(k+1);
+		phase_x[k] = random.Uniform(0.0f, 2*kPi);
+		phase_y[k] = random.Uniform(0.0f, 2*kPi);
+	}
+	xs->resize(n);
+	ys->resize(n);
+	for(int i=0; i<n; i++) {
+		float t = n > 1 ? (float)i/(n-1) : 0.0f;
+		float x = 0.0f, y = 0.0f;
+		for(int k=0; k<kHarmonics; k++) {
+			x += ax[k]*cos((k+1)*kPi*t + phase_x[k]);
+			y += ay[k]*sin((k+1)*kPi*t + phase_y[k]);
+		}
+		(*xs)[i] = size + x;
+		(*ys)[i] = size + y;
+	}
+}
+
+Gesture *MakeStroke(unsigned int seed, int n, float size) {
+	std::vector<float> xs, ys;
+	Stroke(seed, n, size, &xs, &ys);
+	Gesture *g = new Gesture;
+	g->Append(&xs[0], &ys[0], n);
+	return g;
+}
+
+Gesture *MakeQuery(unsigned int seed, int n, float size, float noise) {
+	std::vector<float> xs, ys;
+	Stroke(seed, n, size, &xs, &ys);
+	//A smooth deformation rather than jitter per point, which would make dense strokes much longer than the template.
+	Random random(~seed);
+	float frequency = random.Uniform(1.0f, 4.0f), phase_x = random.Uniform(0.0f, 2*kPi), phase_y = random.Uniform(0.0f, 2*kPi);
+	for(int i=0; i<n; i++) {
+		float t = n > 1 ? (float)i/(n-1) : 0.0f;
+		xs[i] += noise*sin(frequency*2*kPi*t + phase_x);
+		ys[i] += noise*sin(frequency*2*kPi*t + phase_y);
+	}
+	Gesture *g = new Gesture;
+	g->Append(&xs[0], &ys[0], n);
+	return g;
+}
+
+void MakeTemplates(int count, int n, float size, std::vector<std::pair<std::string, Gesture *> > *result) {
+	for(int i=0; i<count; i++) {
+		char name[32];
+		sprintf(name, "t%d", i);
+		Gesture *g = MakeStroke(i, n, size);
+		g->BuildDescriptor();
+		result->push_back(std::make_pair(std::string(name), g));
+	}
+}
+
+void Free(std::vector<std::pair<std::string, Gesture *> > *gestures) {
+	for(int i=0; i<gestures->size(); i++) {
+		delete (*gestures)[i].second;
+	}
+	gestures->clear();
+}
+
+}
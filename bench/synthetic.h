@@ -0,0 +1,43 @@
+#ifndef SYNTHETIC_H_
+#define SYNTHETIC_H_
+
+#include <string>
+#include <vector>
+#include <utility>
+
+class Gesture;
+
+/**
+ * Deterministic generator of gestures for the benchmarks. The same seed gives the same gesture on every platform,
+ * so numbers stay comparable across commits.
+ *
+ * A stroke is a sum of a few random harmonics sampled at n points, smooth like a real stroke whatever n is. Queries
+ * are noisy copies of a template, so that recognition has something to find.
+ */
+namespace synthetic {
+	//Small xorshift generator, rand() differs between C runtimes.
+	class Random {
+	public:
+		explicit Random(unsigned int seed) : state(seed*2654435761u + 1) {}
+
+		unsigned int Next();
+		//Uniform in [low, high).
+		float Uniform(float low, float high);
+
+	private:
+		unsigned int state;
+	};
+
+	//n points of stroke seed, about size pixels across.
+	void Stroke(unsigned int seed, int n, float size, std::vector<float> *xs, std::vector<float> *ys);
+	//Same as a Gesture, owned by the caller.
+	Gesture *MakeStroke(unsigned int seed, int n, float size);
+	//Template seed smoothly bent by up to noise pixels.
+	Gesture *MakeQuery(unsigned int seed, int n, float size, float noise);
+
+	//count templates of n points named "t0", "t1" ..., with Descriptors built. Owned by the caller.
+	void MakeTemplates(int count, int n, float size, std::vector<std::pair<std::string, Gesture *> > *result);
+	void Free(std::vector<std::pair<std::string, Gesture *> > *gestures);
+}
+
+#endif			//SYNTHETIC_H_
@@ -0,0 +1,374 @@
+/**
+ * Load generator of the recognition server, @see server.cpp.
+ *
+ *		loadgen [--unix path | --tcp port] [--clients n] [--strokes n] [--batch n] [--out file] gesture_file
+ *
+ * Every client is a thread with a connection of its own, drawing strokes one after the other. A stroke is a template
+ * of gesture_file, which should be the one the server loaded, resampled every kStep pixels with a little noise and
+ * moved elsewhere, and is sent batch points per POINTS frame. A client waits for the feedback covering its points
+ * before sending more, like a canvas paced by its frames, so the load is closed loop and grows with the clients.
+ * Reported, as JSON on stdout or --out and as a summary on stderr:
+ *		throughput, updates and strokes per second over every client
+ *		update latency, from sending points to the first feedback covering them, percentiles over every update
+ *		result latency, from COMPLETE to RESULT
+ *		how many strokes matched the template they were drawn from
+ */
+#include "protocol.h"
+#include "gesture.h"
+#include "gesture_manager.h"
+#include "native_thread.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <utility>
+
+static const char *kDefaultSocket = "octopocus.sock";
+static const float kStep = 2.0f;			//Pixels between points, about what a mouse reports.
+static const float kNoise = 0.5f;			//Pixels of jitter on every point.
+static const int kReadSize = 64*1024;
+
+static double Now() {
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+struct Options {
+	std::string path;
+	int port;
+	int clients;
+	int strokes;				//Per client.
+	int batch;					//Points per POINTS frame.
+	std::string out;
+	std::string file;
+
+	Options() : port(0), clients(8), strokes(50), batch(4) {}
+};
+
+class Client {
+public:
+	typedef std::vector<std::pair<std::string, const Gesture *> > Gestures;
+
+	std::vector<double> update_latency, result_latency;		//Seconds.
+	int strokes, updates;
+	int matched;				//Strokes matching the template they were drawn from.
+	std::string error;			//Why the client gave up, if it did.
+
+public:
+	//Neither is owned.
+	Client(int _self, const Options *_options, const Gestures *_templates) : strokes(0), updates(0), matched(0),
+				self(_self), options(_options), templates(_templates), fd(-1), random(_self*2654435761u + 1) {}
+	~Client() {
+		if(fd != -1)
+			close(fd);
+	}
+
+	static void Entry(void *argument) {
+		((Client *)argument)->Run();
+	}
+
+private:
+	void Run();
+	bool Connect();
+	//The points of a stroke drawn after template t.
+	void Draw(const Gesture *t, std::vector<float> *xys);
+	bool Send(const std::string &frames);
+	//Read until a frame of type comes, skipping the others. Return false and set error if the connection breaks.
+	bool Receive(int type, std::string *payload);
+	//Uniform in [-1, 1), a small xorshift so that every run draws the same strokes.
+	float Jitter();
+
+private:
+	int self;
+	const Options *options;
+	const Gestures *templates;
+	int fd;
+	std::string input;
+	unsigned int random;
+};
+
+void Client::Run() {
+	if(!Connect())
+		return;
+
+	std::vector<float> xys;
+	std::string frames, payload;
+	for(int s=0; s<options->strokes; s++) {
+		//Clients walk the templates from different places, so that they do not draw the same strokes in lockstep.
+		int t = (self*7919 + s) % templates->size();
+		Draw((*templates)[t].second, &xys);
+		unsigned int id = s;
+		int count = xys.size()/2;
+
+		frames.clear();
+		protocol::WriteBegin(&frames, id);
+		for(int sent=0; sent<count;) {
+			int n = count-sent < options->batch ? count-sent : options->batch;
+			protocol::WritePoints(&frames, &xys[sent*2], n);
+			sent += n;
+			double start = Now();
+			if(!Send(frames))
+				return;
+			frames.clear();
+			//Wait for the feedback covering these points.
+			for(;;) {
+				if(!Receive(protocol::FEEDBACK, &payload))
+					return;
+				protocol::Reader r(payload.data(), payload.size());
+				unsigned int stroke = r.U32();
+				int points = r.U32();
+				if(r.Ok() && stroke == id && points >= sent)
+					break;
+			}
+			update_latency.push_back(Now()-start);
+			updates++;
+		}
+
+		protocol::WriteComplete(&frames);
+		double start = Now();
+		if(!Send(frames))
+			return;
+		for(;;) {
+			if(!Receive(protocol::RESULT, &payload))
+				return;
+			protocol::Reader r(payload.data(), payload.size());
+			unsigned int stroke = r.U32();
+			int match = (int)r.U32();
+			r.F32();
+			std::string name;
+			r.Bytes(r.U8(), &name);
+			if(!r.Done()) {
+				error = "malformed result";
+				return;
+			}
+			if(stroke != id)
+				continue;
+			result_latency.push_back(Now()-start);
+			matched += match != -1 && name == (*templates)[t].first;
+			break;
+		}
+		strokes++;
+	}
+}
+
+bool Client::Connect() {
+	bool tcp = options->path.empty();
+	fd = socket(tcp ? AF_INET : AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if(fd == -1) {
+		error = strerror(errno);
+		return false;
+	}
+	int result;
+	if(tcp) {
+		sockaddr_in address;
+		memset(&address, 0, sizeof(address));
+		address.sin_family = AF_INET;
+		address.sin_port = htons(options->port);
+		address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		result = connect(fd, (sockaddr *)&address, sizeof(address));
+		int on = 1;
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+	}
+	else {
+		sockaddr_un address;
+		memset(&address, 0, sizeof(address));
+		address.sun_family = AF_UNIX;
+		strncpy(address.sun_path, options->path.c_str(), sizeof(address.sun_path)-1);
+		result = connect(fd, (sockaddr *)&address, sizeof(address));
+	}
+	if(result != 0) {
+		error = strerror(errno);
+		return false;
+	}
+	return true;
+}
+
+float Client::Jitter() {
+	random ^= random << 13;
+	random ^= random >> 17;
+	random ^= random << 5;
+	return (random >> 8)*(2.0f/(1 << 24)) - 1.0f;
+}
+
+void Client::Draw(const Gesture *t, std::vector<float> *xys) {
+	xys->clear();
+	int n = (int)(t->Length()/kStep) + 1;
+	float x = 100.0f + self%16*10.0f, y = 100.0f + self/16%16*10.0f;
+	for(int i=0; i<n; i++) {
+		Gesture::Point p = t->Sample(n > 1 ? (float)i/(n-1) : 0.0f);
+		xys->push_back(p.x + x + Jitter()*kNoise);
+		xys->push_back(p.y + y + Jitter()*kNoise);
+	}
+}
+
+bool Client::Send(const std::string &frames) {
+	size_t sent = 0;
+	while(sent < frames.size()) {
+		ssize_t n = send(fd, frames.data()+sent, frames.size()-sent, MSG_NOSIGNAL);
+		if(n < 0) {
+			if(errno == EINTR)
+				continue;
+			error = strerror(errno);
+			return false;
+		}
+		sent += n;
+	}
+	return true;
+}
+
+bool Client::Receive(int type, std::string *payload) {
+	char buffer[kReadSize];
+	for(;;) {
+		int size, frame_type;
+		if(protocol::Peek(input.data(), input.size(), &size, &frame_type)) {
+			if(size < 0) {
+				error = "malformed frame";
+				return false;
+			}
+			payload->assign(input, protocol::kHeaderSize, size);
+			input.erase(0, protocol::kHeaderSize+size);
+			if(frame_type == type)
+				return true;
+			continue;
+		}
+		ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+		if(n > 0) {
+			input.append(buffer, n);
+			continue;
+		}
+		if(n < 0 && errno == EINTR)
+			continue;
+		error = n == 0 ? "connection closed by the server" : strerror(errno);
+		return false;
+	}
+}
+
+//Percentiles in microseconds, nearest rank.
+static void WriteLatency(FILE *file, const char *name, std::vector<double> latency) {
+	std::sort(latency.begin(), latency.end());
+	fprintf(file, "\t\"%s\": {\"count\": %d", name, (int)latency.size());
+	static const double kPercentiles[] = {50, 90, 99, 99.9};
+	static const char *kNames[] = {"p50", "p90", "p99", "p999"};
+	for(int i=0; i<sizeof(kPercentiles)/sizeof(kPercentiles[0]); i++) {
+		double v = latency.empty() ? 0.0 : latency[(int)((latency.size()-1)*kPercentiles[i]/100.0 + 0.5)];
+		fprintf(file, ", \"%s\": %.1f", kNames[i], v*1e6);
+	}
+	fprintf(file, ", \"max\": %.1f}", latency.empty() ? 0.0 : latency.back()*1e6);
+	if(!latency.empty()) {
+		fprintf(stderr, "%s: %d, p50 %.0f us, p99 %.0f us, max %.0f us\n", name, (int)latency.size(),
+			latency[(latency.size()-1)/2]*1e6, latency[(int)((latency.size()-1)*0.99 + 0.5)]*1e6, latency.back()*1e6);
+	}
+}
+
+int main(int argc, char **argv) {
+	Options options;
+	bool usage = false;
+	for(int i=1; i<argc; i++) {
+		std::string arg = argv[i];
+		if(arg == "--unix" && i+1 < argc)
+			options.path = argv[++i];
+		else if(arg == "--tcp" && i+1 < argc)
+			options.port = atoi(argv[++i]);
+		else if(arg == "--clients" && i+1 < argc)
+			options.clients = atoi(argv[++i]);
+		else if(arg == "--strokes" && i+1 < argc)
+			options.strokes = atoi(argv[++i]);
+		else if(arg == "--batch" && i+1 < argc)
+			options.batch = atoi(argv[++i]);
+		else if(arg == "--out" && i+1 < argc)
+			options.out = argv[++i];
+		else if(options.file.empty() && arg[0] != '-')
+			options.file = arg;
+		else
+			usage = true;
+	}
+	if(usage || options.file.empty() || (!options.path.empty() && options.port != 0) || options.clients < 1 ||
+			options.batch < 1 || options.batch > protocol::kMaxPoints) {
+		fprintf(stderr, "Usage: %s [--unix path | --tcp port] [--clients n] [--strokes n] [--batch n] [--out file] "
+			"gesture_file\n", argv[0]);
+		return 1;
+	}
+	if(options.path.empty() && options.port == 0)
+		options.path = kDefaultSocket;
+
+	//Only for the shapes and names, strokes are drawn from them.
+	GestureManager manager;
+	if(!manager.Load(options.file)) {
+		fprintf(stderr, "%s: %s.\n", options.file.c_str(), manager.GetError().c_str());
+		return 1;
+	}
+	Client::Gestures templates;
+	manager.GetAll(&templates);
+	if(templates.empty()) {
+		fprintf(stderr, "%s: no gestures.\n", options.file.c_str());
+		return 1;
+	}
+
+	std::vector<Client *> clients;
+	std::vector<NativeThread *> threads;
+	double start = Now();
+	for(int i=0; i<options.clients; i++) {
+		clients.push_back(new Client(i, &options, &templates));
+		threads.push_back(new NativeThread);
+		if(!threads.back()->Start(Client::Entry, clients.back())) {
+			fprintf(stderr, "Cannot start client %d.\n", i);
+			return 1;
+		}
+	}
+	std::vector<double> update_latency, result_latency;
+	int strokes = 0, updates = 0, matched = 0, failed = 0;
+	for(int i=0; i<options.clients; i++) {
+		threads[i]->Join();
+		delete threads[i];
+		const Client &c = *clients[i];
+		update_latency.insert(update_latency.end(), c.update_latency.begin(), c.update_latency.end());
+		result_latency.insert(result_latency.end(), c.result_latency.begin(), c.result_latency.end());
+		strokes += c.strokes;
+		updates += c.updates;
+		matched += c.matched;
+		if(!c.error.empty()) {
+			fprintf(stderr, "Client %d: %s.\n", i, c.error.c_str());
+			failed++;
+		}
+		delete clients[i];
+	}
+	double elapsed = Now()-start;
+
+	FILE *file = options.out.empty() ? stdout : fopen(options.out.c_str(), "w");
+	if(!file) {
+		fprintf(stderr, "Cannot write %s.\n", options.out.c_str());
+		return 1;
+	}
+	fprintf(file, "{\n");
+	fprintf(file, "\t\"clients\": %d,\n", options.clients);
+	fprintf(file, "\t\"failed\": %d,\n", failed);
+	fprintf(file, "\t\"batch\": %d,\n", options.batch);
+	fprintf(file, "\t\"seconds\": %.3f,\n", elapsed);
+	fprintf(file, "\t\"strokes\": %d,\n", strokes);
+	fprintf(file, "\t\"matched\": %d,\n", matched);
+	fprintf(file, "\t\"updates_per_second\": %.1f,\n", updates/elapsed);
+	fprintf(file, "\t\"strokes_per_second\": %.1f,\n", strokes/elapsed);
+	WriteLatency(file, "update_latency_us", update_latency);
+	fprintf(file, ",\n");
+	WriteLatency(file, "result_latency_us", result_latency);
+	fprintf(file, "\n}\n");
+	if(file != stdout)
+		fclose(file);
+	fprintf(stderr, "%d clients, %d strokes in %.2f s: %.0f updates/s, %.1f strokes/s, %d of %d matched their template.\n",
+		options.clients, strokes, elapsed, updates/elapsed, strokes/elapsed, matched, strokes);
+	return failed ? 1 : 0;
+}
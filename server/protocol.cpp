@@ -0,0 +1,175 @@
+#include "protocol.h"
+#include "feedback.h"
+
+#include <assert.h>
+#include <string.h>
+
+namespace protocol {
+	/****************Encoding, byte by byte so that it does not depend on the host.****************/
+	static void PutU8(std::string *out, unsigned char v) {
+		out->push_back((char)v);
+	}
+
+	static void PutU16(std::string *out, unsigned short v) {
+		PutU8(out, v & 0xff);
+		PutU8(out, v >> 8);
+	}
+
+	static void PutU32(std::string *out, unsigned int v) {
+		for(int i=0; i<4; i++) {
+			PutU8(out, (v >> (i*8)) & 0xff);
+		}
+	}
+
+	static void PutF32(std::string *out, float v) {
+		unsigned int bits;
+		memcpy(&bits, &v, 4);
+		PutU32(out, bits);
+	}
+
+	static unsigned int GetU32(const char *data) {
+		const unsigned char *p = (const unsigned char *)data;
+		return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+	}
+
+	//Start a frame, return where its size goes.
+	static size_t Open(std::string *out, Type type) {
+		size_t start = out->size();
+		PutU32(out, 0);
+		PutU8(out, type);
+		return start;
+	}
+
+	static void Close(std::string *out, size_t start) {
+		unsigned int size = out->size()-start-kHeaderSize;
+		assert(size <= kMaxPayload);
+		for(int i=0; i<4; i++) {
+			(*out)[start+i] = (char)((size >> (i*8)) & 0xff);
+		}
+	}
+
+	/****************Reader.****************/
+	bool Reader::Take(int size, const char **data) {
+		if(!ok || end-cur < size) {
+			ok = false;
+			return false;
+		}
+		*data = cur;
+		cur += size;
+		return true;
+	}
+
+	unsigned char Reader::U8() {
+		const char *p;
+		return Take(1, &p) ? (unsigned char)p[0] : 0;
+	}
+
+	unsigned short Reader::U16() {
+		const char *p;
+		return Take(2, &p) ? (unsigned short)((unsigned char)p[0] | ((unsigned char)p[1] << 8)) : 0;
+	}
+
+	unsigned int Reader::U32() {
+		const char *p;
+		return Take(4, &p) ? GetU32(p) : 0;
+	}
+
+	float Reader::F32() {
+		unsigned int bits = U32();
+		float v;
+		memcpy(&v, &bits, 4);
+		return v;
+	}
+
+	void Reader::Bytes(int size, std::string *result) {
+		const char *p;
+		if(Take(size, &p))
+			result->assign(p, size);
+		else
+			result->clear();
+	}
+
+	bool Peek(const char *data, int size, int *payload, int *type) {
+		if(size < kHeaderSize)
+			return false;
+		unsigned int n = GetU32(data);
+		*type = (unsigned char)data[4];
+		if(n > kMaxPayload) {
+			*payload = -1;
+			return true;
+		}
+		*payload = n;
+		return size-kHeaderSize >= (int)n;
+	}
+
+	/****************Frames.****************/
+	void WriteBegin(std::string *out, unsigned int stroke) {
+		size_t start = Open(out, BEGIN);
+		PutU32(out, stroke);
+		Close(out, start);
+	}
+
+	void WritePoints(std::string *out, const float *xys, int count) {
+		assert(count >= 0 && count <= kMaxPoints);
+		size_t start = Open(out, POINTS);
+		PutU16(out, count);
+		for(int i=0; i<count*2; i++) {
+			PutF32(out, xys[i]);
+		}
+		Close(out, start);
+	}
+
+	void WriteComplete(std::string *out) {
+		Close(out, Open(out, COMPLETE));
+	}
+
+	void WriteCancel(std::string *out) {
+		Close(out, Open(out, CANCEL));
+	}
+
+	void WriteFeedback(std::string *out, const Feedback &feedback, int points) {
+		size_t start = Open(out, FEEDBACK);
+		PutU32(out, feedback.stroke);
+		PutU32(out, points);
+		PutU8(out, feedback.items.size());
+		for(int i=0; i<feedback.items.size(); i++) {
+			const Feedback::Item &item = feedback.items[i];
+			PutU32(out, item.index);
+			PutF32(out, item.falloff);
+			PutF32(out, item.transform.x);
+			PutF32(out, item.transform.y);
+			PutU8(out, item.pen_count);
+			for(int j=0; j<item.pen_count; j++) {
+				const Feedback::Pen &pen = item.pens[j];
+				PutF32(out, pen.start);
+				PutU8(out, pen.red);
+				PutU8(out, pen.green);
+				PutU8(out, pen.blue);
+				PutU8(out, pen.alpha);
+				PutF32(out, pen.width);
+			}
+		}
+		PutU8(out, feedback.labels.size());
+		for(int i=0; i<feedback.labels.size(); i++) {
+			const Feedback::Label &label = feedback.labels[i];
+			size_t size = strlen(label.text);
+			PutU8(out, size);
+			out->append(label.text, size);
+			PutF32(out, label.x);
+			PutF32(out, label.y);
+		}
+		Close(out, start);
+	}
+
+	void WriteResult(std::string *out, unsigned int stroke, int match, float falloff, const std::string &name) {
+		size_t start = Open(out, RESULT);
+		PutU32(out, stroke);
+		PutU32(out, (unsigned int)match);
+		PutF32(out, falloff);
+		//Names longer than a byte can tell are cut, like labels they are only for display.
+		size_t size = name.size() < 0xff ? name.size() : 0xff;
+		PutU8(out, size);
+		out->append(name.data(), size);
+		Close(out, start);
+	}
+}
@@ -0,0 +1,90 @@
+#ifndef PROTOCOL_H_
+#define PROTOCOL_H_
+
+#include <string>
+
+struct Feedback;
+
+/**
+ * Wire protocol of the recognition server, @see server.cpp.
+ *
+ * Every message is a frame: a 4 byte payload size, a 1 byte type and the payload. Numbers are little endian, floats
+ * are IEEE 754 single precision. A connection tracks one stroke at a time, the way a canvas does.
+ *
+ * Client to server:
+ *		BEGIN		u32 stroke								A new stroke, any one in progress is dropped.
+ *		POINTS		u16 count, count x (f32 x, f32 y)		Appended to the stroke.
+ *		COMPLETE											Find the final match of the stroke.
+ *		CANCEL												Drop the stroke.
+ *
+ * Server to client:
+ *		FEEDBACK	u32 stroke, u32 points, u8 items, items x item, u8 labels, labels x label
+ *						item:	u32 template, f32 falloff, f32 x, f32 y, u8 pens, pens x (f32 start, u8 rgba[4], f32 width)
+ *						label:	u8 size, size bytes of text, f32 x, f32 y
+ *					What the canvas would draw, @see Feedback and FeedForward. points counts the points received for
+ *					the stroke that it covers. Updates arriving faster than they are matched are coalesced, so a
+ *					FEEDBACK may cover several POINTS, and one POINTS may get none if COMPLETE follows right away.
+ *		RESULT		u32 stroke, i32 match, f32 falloff, u8 size, size bytes of name
+ *					Final match, match is -1 if nothing matches. Every COMPLETE gets one, in order.
+ *
+ * Templates are numbered as they are loaded by the server, e.g. the order of a gesture file. A malformed frame closes
+ * the connection. A client that shuts down its sending side still gets the replies to everything it sent, then the
+ * server closes the connection.
+ */
+namespace protocol {
+	enum Type {
+		BEGIN = 1,
+		POINTS,
+		COMPLETE,
+		CANCEL,
+
+		FEEDBACK = 0x81,
+		RESULT
+	};
+
+	enum {kHeaderSize = 5};
+	enum {kMaxPayload = 1 << 20};
+	enum {kMaxPoints = 0xffff};			//Per POINTS frame.
+
+	//Reads a payload, any read past its end gives 0 and clears ok.
+	class Reader {
+	public:
+		Reader(const char *data, int size) : cur(data), end(data+size), ok(true) {}
+
+		unsigned char U8();
+		unsigned short U16();
+		unsigned int U32();
+		float F32();
+		//size bytes into result.
+		void Bytes(int size, std::string *result);
+
+		bool Ok() const { return ok; }
+		//Everything read and nothing more.
+		bool Done() const { return ok && cur == end; }
+
+	private:
+		bool Take(int size, const char **data);
+
+	private:
+		const char *cur, *end;
+		bool ok;
+	};
+
+	/**
+	 * Size of the payload of the frame at the front of data and its type, return false if data does not hold the whole
+	 * frame yet. A payload larger than kMaxPayload is malformed and gives -1.
+	 */
+	bool Peek(const char *data, int size, int *payload, int *type);
+
+	/****************Append a frame to out.****************/
+	void WriteBegin(std::string *out, unsigned int stroke);
+	//count points of xys, interleaved x and y. Up to kMaxPoints.
+	void WritePoints(std::string *out, const float *xys, int count);
+	void WriteComplete(std::string *out);
+	void WriteCancel(std::string *out);
+	//points overrides Feedback::points, @see FEEDBACK.
+	void WriteFeedback(std::string *out, const Feedback &feedback, int points);
+	void WriteResult(std::string *out, unsigned int stroke, int match, float falloff, const std::string &name);
+}
+
+#endif			//PROTOCOL_H_
@@ -0,0 +1,614 @@
+/**
+ * Recognition server, one gesture library shared by many clients, @see protocol.h for the wire protocol.
+ *
+ *		server [--unix path | --tcp port] [--threads n] gesture_file
+ *
+ * Clients connect over a Unix domain socket, octopocus.sock by default, or over TCP on the loopback interface. Every
+ * connection is a session with a stroke of its own. As it grows the stroke is tracked by a Recognizer and presented by
+ * a FeedForward, the same way RecognitionStage does for the canvas, and once complete it is matched through the
+ * GestureIndex of the library. The library is loaded once and every session reads the same GestureSnapshot of it.
+ *
+ * One thread runs an epoll loop. Every time it wakes up, what the ready connections sent is read and applied to their
+ * sessions, then every session with something to do runs as one job on a WorkerPool, a session per chunk, and the
+ * replies are written back. The more clients, the larger the batches: updates of a session within a batch are
+ * coalesced into one round of matching, and the pool is kept busy across sessions rather than within one stroke.
+ *
+ * Linux only. Stops on SIGINT or SIGTERM and tells on stderr how requests were batched.
+ */
+#include "protocol.h"
+#include "feedback.h"
+#include "feedforward.h"
+#include "gesture.h"
+#include "gesture_index.h"
+#include "gesture_manager.h"
+#include "gesture_snapshot.h"
+#include "recognizer.h"
+#include "worker_pool.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <deque>
+#include <set>
+#include <string>
+#include <vector>
+#include <utility>
+
+static const char *kDefaultSocket = "octopocus.sock";
+static const int kMaxEvents = 256;				//Connections handled per wake up at most.
+static const int kReadSize = 64*1024;
+static const size_t kMaxOutput = 16 << 20;		//Replies a client may leave unread before it is dropped.
+
+static volatile sig_atomic_t quit = 0;
+
+static void OnSignal(int) {
+	quit = 1;
+}
+
+/**
+ * A connection and its stroke. The loop thread receives and replies, Process runs on any thread of the pool in
+ * between. What the two share is handed over by the pending flags, which only change on the loop thread.
+ */
+class Session {
+public:
+	typedef GestureSnapshot::Templates Gestures;
+
+private:
+	struct Completion {
+		unsigned int id;
+		Gesture stroke;
+	};
+
+	struct Result {
+		unsigned int id;
+		int match;
+		float falloff;
+	};
+
+public:
+	//Neither is owned, both are shared read only by every session.
+	Session(int fd, const Gestures *templates, const GestureIndex *index);
+
+	int GetFd() const { return fd; }
+
+	/****************Loop thread.****************/
+	/**
+	 * Read what there is, return false if the connection is broken or a frame is malformed. Frames that came before
+	 * the client shut down its side are still applied, and the session is Ended().
+	 */
+	bool Receive();
+	//The client sends nothing more, the session closes once its replies are out.
+	bool Ended() const { return ended; }
+	//Whether Process has anything to do.
+	bool Pending() const { return begin_pending || update_pending || end_pending || !completions.empty(); }
+	//Append the replies Process came up with to the output, return false if the client is too far behind.
+	bool Reply();
+	//Write as much output as the socket takes, return false if the connection is broken.
+	bool Flush();
+	//Output is waiting for the socket to become writable.
+	bool Blocked() const { return !output.empty(); }
+
+	/****************Pool.****************/
+	void Process();
+
+private:
+	//Apply one frame, return false if it is malformed.
+	bool Apply(int type, protocol::Reader &r);
+	void Present();
+
+private:
+	int fd;
+	const Gestures *templates;
+	const GestureIndex *index;
+	std::string input, output;
+
+	//Loop thread.
+	bool ended;
+	bool tracking;				//Between BEGIN and COMPLETE or CANCEL.
+	bool begun;					//The stroke has been handed to the recognizer.
+	unsigned int stroke_id;
+	int received;				//Points of the stroke so far.
+	Gesture stroke;
+
+	//Set by the loop thread, cleared by Process.
+	bool begin_pending, update_pending;
+	bool end_pending;			//The stroke the recognizer tracks is over.
+	std::deque<Completion> completions;
+
+	//Process.
+	Recognizer recognizer;
+	FeedForward feedforward;
+	bool recognizing;
+	Feedback feedback;
+	bool presented;				//Feedback not replied yet.
+	int presented_points;
+	std::vector<Result> results;
+};
+
+Session::Session(int _fd, const Gestures *_templates, const GestureIndex *_index) : fd(_fd), templates(_templates),
+			index(_index), ended(false), tracking(false), begun(false), stroke_id(0), received(0), begin_pending(false),
+			update_pending(false), end_pending(false), recognizing(false), presented(false), presented_points(0) {
+	feedback.items.reserve(FeedForward::kMaxCandidates);
+	feedback.labels.reserve(FeedForward::kMaxCandidates);
+}
+
+bool Session::Receive() {
+	char buffer[kReadSize];
+	for(;;) {
+		ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+		if(n > 0) {
+			input.append(buffer, n);
+			continue;
+		}
+		if(n == 0) {
+			ended = true;
+			break;
+		}
+		if(errno == EINTR)
+			continue;
+		if(errno == EAGAIN || errno == EWOULDBLOCK)
+			break;
+		return false;
+	}
+
+	size_t offset = 0;
+	int payload, type;
+	while(protocol::Peek(input.data()+offset, input.size()-offset, &payload, &type)) {
+		if(payload < 0)
+			return false;
+		protocol::Reader r(input.data()+offset+protocol::kHeaderSize, payload);
+		if(!Apply(type, r))
+			return false;
+		offset += protocol::kHeaderSize+payload;
+	}
+	input.erase(0, offset);
+	return true;
+}
+
+bool Session::Apply(int type, protocol::Reader &r) {
+	switch(type) {
+	case protocol::BEGIN:
+		stroke_id = r.U32();
+		if(!r.Done())
+			return false;
+		stroke = Gesture();
+		stroke.Reserve(Gesture::kStrokeReserve);
+		stroke.SetSimplify(Gesture::kStrokeSimplify);
+		tracking = true;
+		begun = false;
+		received = 0;
+		//Handed to the recognizer along with the first points.
+		begin_pending = update_pending = false;
+		return true;
+	case protocol::POINTS: {
+		int count = r.U16();
+		if(!tracking)
+			return false;
+		for(int i=0; i<count; i++) {
+			float x = r.F32();
+			float y = r.F32();
+			stroke.PushBack(x, y);
+		}
+		if(!r.Done())
+			return false;
+		received += count;
+		if(stroke.Size() == 0)
+			return true;
+		//A begin covers whatever came with it.
+		if(!begun) {
+			begun = true;
+			begin_pending = true;
+		}
+		else if(!begin_pending) {
+			update_pending = true;
+		}
+		return true;
+	}
+	case protocol::COMPLETE:
+		if(!r.Done() || !tracking)
+			return false;
+		completions.push_back(Completion());
+		completions.back().id = stroke_id;
+		completions.back().stroke = stroke;
+		//Like RecognitionStage, pending updates of a complete stroke are not worth matching.
+		tracking = false;
+		begin_pending = update_pending = false;
+		end_pending = true;
+		return true;
+	case protocol::CANCEL:
+		if(!r.Done())
+			return false;
+		tracking = false;
+		begin_pending = update_pending = false;
+		end_pending = true;
+		return true;
+	default:
+		return false;
+	}
+}
+
+void Session::Process() {
+	if(end_pending) {
+		if(recognizing)
+			recognizer.End();
+		recognizing = false;
+		end_pending = false;
+	}
+	for(int i=0; i<completions.size(); i++) {
+		Result r;
+		r.id = completions[i].id;
+		r.falloff = 0.0f;
+		r.match = completions[i].stroke.Size() == 0 ? -1 :
+			recognizer.BestMatch(&completions[i].stroke, *index, &r.falloff);
+		results.push_back(r);
+	}
+	completions.clear();
+
+	if(begin_pending) {
+		recognizer.Begin(&stroke, *templates);
+		feedforward.Begin();
+		recognizing = true;
+		Present();
+	}
+	else if(update_pending && recognizing) {
+		recognizer.Update();
+		Present();
+	}
+	begin_pending = update_pending = false;
+}
+
+void Session::Present() {
+	feedforward.Present(recognizer, stroke, stroke_id, *templates, &feedback);
+	presented = true;
+	presented_points = received;
+}
+
+bool Session::Reply() {
+	for(int i=0; i<results.size(); i++) {
+		const Result &r = results[i];
+		protocol::WriteResult(&output, r.id, r.match, r.falloff, r.match == -1 ? std::string() : index->GetName(r.match));
+	}
+	results.clear();
+	if(presented) {
+		protocol::WriteFeedback(&output, feedback, presented_points);
+		presented = false;
+	}
+	return output.size() <= kMaxOutput;
+}
+
+bool Session::Flush() {
+	size_t sent = 0;
+	while(sent < output.size()) {
+		ssize_t n = send(fd, output.data()+sent, output.size()-sent, MSG_NOSIGNAL);
+		if(n >= 0) {
+			sent += n;
+			continue;
+		}
+		if(errno == EINTR)
+			continue;
+		if(errno == EAGAIN || errno == EWOULDBLOCK)
+			break;
+		return false;
+	}
+	output.erase(0, sent);
+	return true;
+}
+
+class Server {
+public:
+	typedef GestureSnapshot::Templates Gestures;
+
+	//How requests were batched.
+	struct Stats {
+		int connections;
+		long long rounds;			//Jobs run on the pool.
+		long long processed;		//Sessions over all rounds.
+		int max_batch;
+
+		Stats() : connections(0), rounds(0), processed(0), max_batch(0) {}
+	};
+
+private:
+	class RoundTask;
+
+public:
+	//None is owned.
+	Server(const Gestures *templates, const GestureIndex *index, WorkerPool *pool);
+	~Server();
+
+	//Either path or port, return false and tell on stderr if it fails.
+	bool Listen(const std::string &path, int port);
+	//Until quit is set.
+	void Run();
+
+	const Stats &GetStats() const { return stats; }
+
+private:
+	void Accept();
+	void Close(Session *s);
+	//Watch s for output too while it is blocked, and for input only until it is ended.
+	void Watch(Session *s);
+	//Process every session of batch on the pool and reply.
+	void Round();
+
+private:
+	const Gestures *templates;
+	const GestureIndex *index;
+	WorkerPool *pool;
+	int epoll;
+	int listener;
+	bool tcp;
+	std::string path;			//Of the Unix socket, removed when done.
+	std::set<Session *> sessions;
+	std::vector<Session *> batch;
+	Stats stats;
+};
+
+class Server::RoundTask : public WorkerPool::Task {
+public:
+	RoundTask(const std::vector<Session *> &_batch) : batch(_batch) {}
+
+	virtual void Run(int chunk, int begin, int end) {
+		for(int i=begin; i<end; i++) {
+			batch[i]->Process();
+		}
+	}
+
+private:
+	const std::vector<Session *> &batch;
+};
+
+Server::Server(const Gestures *_templates, const GestureIndex *_index, WorkerPool *_pool) : templates(_templates),
+			index(_index), pool(_pool), epoll(-1), listener(-1), tcp(false) {
+	batch.reserve(kMaxEvents);
+}
+
+Server::~Server() {
+	while(!sessions.empty()) {
+		Close(*sessions.begin());
+	}
+	if(listener != -1)
+		close(listener);
+	if(epoll != -1)
+		close(epoll);
+	if(!path.empty())
+		unlink(path.c_str());
+}
+
+bool Server::Listen(const std::string &_path, int port) {
+	epoll = epoll_create1(EPOLL_CLOEXEC);
+	if(epoll == -1) {
+		perror("epoll_create1");
+		return false;
+	}
+
+	tcp = _path.empty();
+	listener = socket(tcp ? AF_INET : AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if(listener == -1) {
+		perror("socket");
+		return false;
+	}
+	int result;
+	if(tcp) {
+		int on = 1;
+		setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+		sockaddr_in address;
+		memset(&address, 0, sizeof(address));
+		address.sin_family = AF_INET;
+		address.sin_port = htons(port);
+		address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		result = bind(listener, (sockaddr *)&address, sizeof(address));
+	}
+	else {
+		sockaddr_un address;
+		memset(&address, 0, sizeof(address));
+		address.sun_family = AF_UNIX;
+		if(_path.size() >= sizeof(address.sun_path)) {
+			fprintf(stderr, "%s: path too long.\n", _path.c_str());
+			return false;
+		}
+		strcpy(address.sun_path, _path.c_str());
+		//Left over by a server that did not stop cleanly.
+		unlink(_path.c_str());
+		result = bind(listener, (sockaddr *)&address, sizeof(address));
+		if(result == 0)
+			path = _path;
+	}
+	if(result != 0 || listen(listener, SOMAXCONN) != 0) {
+		perror("bind");
+		return false;
+	}
+
+	epoll_event event;
+	event.events = EPOLLIN;
+	event.data.ptr = 0;
+	if(epoll_ctl(epoll, EPOLL_CTL_ADD, listener, &event) != 0) {
+		perror("epoll_ctl");
+		return false;
+	}
+	return true;
+}
+
+void Server::Run() {
+	epoll_event events[kMaxEvents];
+	while(!quit) {
+		int n = epoll_wait(epoll, events, kMaxEvents, -1);
+		if(n < 0) {
+			if(errno == EINTR)
+				continue;
+			perror("epoll_wait");
+			return;
+		}
+
+		//Each connection shows up once per wake up, so a session closed here is never in the batch.
+		for(int i=0; i<n; i++) {
+			Session *s = (Session *)events[i].data.ptr;
+			if(!s) {
+				Accept();
+				continue;
+			}
+			if(events[i].events & EPOLLOUT) {
+				if(!s->Flush() || (s->Ended() && !s->Blocked())) {
+					Close(s);
+					continue;
+				}
+				Watch(s);
+			}
+			if(events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+				if(!s->Receive()) {
+					Close(s);
+					continue;
+				}
+				//An ended session still gets the replies to what it sent before.
+				if(s->Pending())
+					batch.push_back(s);
+				else if(s->Ended() && !s->Blocked())
+					Close(s);
+				else if(s->Ended())
+					Watch(s);
+			}
+		}
+		Round();
+	}
+}
+
+void Server::Accept() {
+	for(;;) {
+		int fd = accept4(listener, 0, 0, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if(fd == -1) {
+			if(errno == EINTR)
+				continue;
+			if(errno != EAGAIN && errno != EWOULDBLOCK)
+				perror("accept4");
+			return;
+		}
+		if(tcp) {
+			//Replies are small and latency bound.
+			int on = 1;
+			setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+		}
+		Session *s = new Session(fd, templates, index);
+		epoll_event event;
+		event.events = EPOLLIN;
+		event.data.ptr = s;
+		if(epoll_ctl(epoll, EPOLL_CTL_ADD, fd, &event) != 0) {
+			perror("epoll_ctl");
+			close(fd);
+			delete s;
+			continue;
+		}
+		sessions.insert(s);
+		stats.connections++;
+	}
+}
+
+void Server::Close(Session *s) {
+	epoll_ctl(epoll, EPOLL_CTL_DEL, s->GetFd(), 0);
+	close(s->GetFd());
+	sessions.erase(s);
+	delete s;
+}
+
+void Server::Watch(Session *s) {
+	epoll_event event;
+	event.events = (s->Ended() ? 0 : EPOLLIN) | (s->Blocked() ? EPOLLOUT : 0);
+	event.data.ptr = s;
+	epoll_ctl(epoll, EPOLL_CTL_MOD, s->GetFd(), &event);
+}
+
+void Server::Round() {
+	if(batch.empty())
+		return;
+
+	RoundTask task(batch);
+	if(pool)
+		pool->Run(&task, batch.size(), 1);
+	else
+		task.Run(0, 0, batch.size());
+	stats.rounds++;
+	stats.processed += batch.size();
+	stats.max_batch = batch.size() > stats.max_batch ? batch.size() : stats.max_batch;
+
+	for(int i=0; i<batch.size(); i++) {
+		Session *s = batch[i];
+		bool blocked = s->Blocked();
+		if(!s->Reply() || !s->Flush() || (s->Ended() && !s->Blocked())) {
+			Close(s);
+			continue;
+		}
+		if(blocked != s->Blocked() || s->Ended())
+			Watch(s);
+	}
+	batch.clear();
+}
+
+int main(int argc, char **argv) {
+	std::string path;
+	int port = 0;
+	int threads = 0;
+	std::string file;
+	bool usage = false;
+	for(int i=1; i<argc; i++) {
+		std::string arg = argv[i];
+		if(arg == "--unix" && i+1 < argc)
+			path = argv[++i];
+		else if(arg == "--tcp" && i+1 < argc)
+			port = atoi(argv[++i]);
+		else if(arg == "--threads" && i+1 < argc)
+			threads = atoi(argv[++i]);
+		else if(file.empty() && arg[0] != '-')
+			file = arg;
+		else
+			usage = true;
+	}
+	if(usage || file.empty() || (!path.empty() && port != 0)) {
+		fprintf(stderr, "Usage: %s [--unix path | --tcp port] [--threads n] gesture_file\n", argv[0]);
+		return 1;
+	}
+	if(path.empty() && port == 0)
+		path = kDefaultSocket;
+
+	//0 threads for one per cpu, the same as the demo.
+	WorkerPool pool(threads);
+	GestureManager manager;
+	manager.SetSimplify(Gesture::kStrokeSimplify.distance);
+	if(!manager.Load(file, &pool)) {
+		fprintf(stderr, "%s: %s.\n", file.c_str(), manager.GetError().c_str());
+		return 1;
+	}
+	//Loaded once, sessions share this snapshot of it.
+	const GestureSnapshot *snapshot = manager.GetSnapshot();
+
+	struct sigaction action;
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = OnSignal;
+	sigaction(SIGINT, &action, 0);
+	sigaction(SIGTERM, &action, 0);
+	signal(SIGPIPE, SIG_IGN);
+
+	Server server(&snapshot->GetTemplates(), &snapshot->GetIndex(), &pool);
+	if(!server.Listen(path, port))
+		return 1;
+	if(port)
+		fprintf(stderr, "%d templates, listening on 127.0.0.1:%d.\n", snapshot->Size(), port);
+	else
+		fprintf(stderr, "%d templates, listening on %s.\n", snapshot->Size(), path.c_str());
+	server.Run();
+
+	const Server::Stats &stats = server.GetStats();
+	fprintf(stderr, "%d connections, %lld rounds, %.2f sessions per round, at most %d.\n", stats.connections,
+		stats.rounds, stats.rounds ? (double)stats.processed/stats.rounds : 0.0, stats.max_batch);
+	snapshot->Release();
+	return 0;
+}
@@ -0,0 +1,61 @@
+#include "alloc_check.h"
+
+#ifdef OCTOPOCUS_COUNT_ALLOCATIONS
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <new>
+
+#ifdef _MSC_VER
+	#define THREAD_LOCAL __declspec(thread)
+#else
+	#define THREAD_LOCAL __thread
+#endif
+
+static THREAD_LOCAL unsigned long allocations = 0;
+
+void *operator new(size_t size) {
+	allocations++;
+	void *p = malloc(size ? size : 1);
+	if(!p)
+		throw std::bad_alloc();
+	return p;
+}
+
+void *operator new[](size_t size) {
+	return operator new(size);
+}
+
+void operator delete(void *p) throw() {
+	free(p);
+}
+
+void operator delete[](void *p) throw() {
+	free(p);
+}
+
+AllocCheck::AllocCheck(bool _armed) : armed(_armed), start(allocations) {
+
+}
+
+AllocCheck::~AllocCheck() {
+	//Not an assert, so that release builds check as well.
+	if(armed && allocations != start) {
+		fprintf(stderr, "AllocCheck: %lu allocations in a checked scope.\n", allocations-start);
+		abort();
+	}
+}
+
+AllocCheck::Exempt::Exempt() : start(allocations) {
+
+}
+
+AllocCheck::Exempt::~Exempt() {
+	allocations = start;
+}
+
+unsigned long AllocCheck::Count() {
+	return allocations;
+}
+
+#endif			//OCTOPOCUS_COUNT_ALLOCATIONS
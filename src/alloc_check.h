@@ -0,0 +1,60 @@
+#ifndef ALLOC_CHECK_H_
+#define ALLOC_CHECK_H_
+
+/**
+ * Test only check that a piece of code stays off the heap, e.g. the steady state of updating a stroke.
+ *
+ * Define OCTOPOCUS_COUNT_ALLOCATIONS to enable it: the global operator new is then replaced by one counting the
+ * allocations of each thread, and an AllocCheck aborts, in release builds too, if its thread made any from its
+ * construction to its destruction. Without the define it is an empty class and costs nothing. bench/alloc runs the
+ * update of a stroke built that way, @see bench/Makefile.
+ *
+ * Only the thread owning the AllocCheck is counted, work it hands to a WorkerPool is not.
+ *
+ * wxWidgets allocates by itself to paint (DCs, graphics contexts, paths, text) and to queue events, which is out of
+ * our hands. Such calls go in an AllocCheck::Exempt, so that everything around them is still checked. So does the
+ * warm-up of a cache, the first time a value is seen.
+ */
+#ifdef OCTOPOCUS_COUNT_ALLOCATIONS
+
+class AllocCheck {
+public:
+	//Allocations of the calling thread within its scope are not counted.
+	class Exempt {
+	public:
+		Exempt();
+		~Exempt();
+
+	private:
+		unsigned long start;
+	};
+
+public:
+	//Nothing is checked unless armed, e.g. before buffers are warmed up.
+	explicit AllocCheck(bool armed = true);
+	~AllocCheck();
+
+	//Allocations made by the calling thread so far.
+	static unsigned long Count();
+
+private:
+	bool armed;
+	unsigned long start;
+};
+
+#else
+
+class AllocCheck {
+public:
+	class Exempt {
+	public:
+		Exempt() {}
+	};
+
+public:
+	explicit AllocCheck(bool armed = true) {}
+};
+
+#endif			//OCTOPOCUS_COUNT_ALLOCATIONS
+
+#endif			//ALLOC_CHECK_H_
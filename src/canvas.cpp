@@ -2,79 +2,389 @@
 #include "gesture.h"
 
 #include "gesture_manager.h"
+#include "alloc_check.h"
+#include "metrics.h"
+#include "timeline.h"
 
-#include <wx/dcbuffer.h>
+#include <assert.h>
+#include <math.h>
+
+#include <wx/graphics.h>
+
+//Room left around what is drawn, for antialiasing.
+static const int kAreaMargin = 2;
+
+//Pixels covered by a box of floats, grown by margin on every side.
+static wxRect AreaOf(float min_x, float min_y, float max_x, float max_y, int margin) {
+	wxRect area(wxPoint((int)floor(min_x), (int)floor(min_y)), wxPoint((int)ceil(max_x), (int)ceil(max_y)));
+	return area.Inflate(margin);
+}
 
 Canvas::Canvas(wxFrame* parent) : 
-			wxPanel(parent), mouse_state(UP), cur_gesture(0) {
+			wxPanel(parent), mouse_state(UP), cur_gesture(0), feedback(0), layers_dirty(true), stroke_drawn(0),
+			frame_timer(this), frame_rate(kDefaultFrameRate), update_pending(false), coalesced(0), stroke_coalesced(0) {
 	SetBackgroundStyle(wxBG_STYLE_PAINT);
 }
 
+Canvas::~Canvas() {
+	delete cur_gesture;
+}
+
+void Canvas::SetFrameRate(int rate) {
+	frame_rate = rate < 0 ? 0 : rate;
+}
+
+void Canvas::Invalidate(const wxRect &area) {
+	if(area.IsEmpty())
+		return;
+	if(frame_rate == 0) {
+		RefreshRect(area, false);
+		return;
+	}
+	pending_area.Union(area);
+	ScheduleFrame();
+}
+
+void Canvas::ScheduleFrame() {
+	if(!frame_timer.IsRunning())
+		frame_timer.StartOnce(1000/frame_rate > 1 ? 1000/frame_rate : 1);
+}
+
+void Canvas::OnFrame(wxTimerEvent &event) {
+	TimelineSpan span("Canvas::OnFrame");
+	//An update, what subscribers do about it and drawing the stroke stay off the heap, but for wx itself.
+	bool update = update_pending && cur_gesture;
+	AllocCheck check(update && cur_gesture->Size() < Gesture::kStrokeReserve);
+	//Only the latest stroke matters to subscribers, one update covers every move since the last one.
+	if(update) {
+		update_pending = false;
+		CanvasEvent e(CANVAS_EVENT, CanvasEvent::UPDATE_GESTURE);
+		e.SetCanvas(this);
+		Publish(e);
+		pending_area.Union(GrowStroke());
+	}
+	if(!pending_area.IsEmpty()) {
+		{
+			AllocCheck::Exempt exempt;
+			RefreshRect(pending_area, false);
+		}
+		pending_area = wxRect();
+	}
+}
+
 void Canvas::PaintEvent(wxPaintEvent & evt) {
-	wxAutoBufferedPaintDC dc(this);
-	
-	//Clear
-	dc.SetBackground(*wxMEDIUM_GREY_BRUSH);
-	dc.Clear();
-	
-	//Render gestures.
-	for(int i=0; i<gestures.size(); i++) {
-		Gesture *cur = gestures[i];
-		Gesture::Point trans = cur->GetTransform();
-		cur->SetTransform(trans.x, trans.y);
-		cur->Render(dc);
+	ScopedTimer timer(Metrics::PAINT);
+	TimelineSpan span("Canvas::PaintEvent");
+	wxPaintDC dc(this);
+	if(layers_dirty)
+		RebuildLayers();
+
+	//The frame holds everything, only what needs repainting is copied.
+	wxMemoryDC source(frame);
+	for(wxRegionIterator it(GetUpdateRegion()); it; ++it) {
+		wxRect r = it.GetRect();
+		dc.Blit(r.x, r.y, r.width, r.height, &source, r.x, r.y);
+	}
+}
+
+void Canvas::OnSize(wxSizeEvent &event) {
+	InvalidateLayers();
+	event.Skip();
+}
+
+void Canvas::InvalidateLayers() {
+	layers_dirty = true;
+	Refresh();
+}
+
+void Canvas::RebuildLayers() {
+	TimelineSpan span("Canvas::RebuildLayers");
+	wxSize size = GetClientSize();
+	size.x = size.x < 1 ? 1 : size.x;
+	size.y = size.y < 1 ? 1 : size.y;
+	if(!background.IsOk() || background.GetSize() != size) {
+		background.Create(size.x, size.y, 24);
+		overlay.Create(size.x, size.y, 24);
+		frame.Create(size.x, size.y, 24);
+	}
+
+	{
+		wxMemoryDC dc(background);
+		dc.SetBackground(*wxMEDIUM_GREY_BRUSH);
+		dc.Clear();
+		wxGraphicsContext *gc = wxGraphicsContext::Create(dc);
+		assert(gc);
+		gc->SetFont(GetFont(), *wxBLACK);
+		for(int i=0; i<gestures.size(); i++) {
+			gestures[i].renderer.Render(gc, *gestures[i].gesture);
+		}
+		for(int i=0; i<texts.size(); i++) {
+			gc->DrawText(texts[i].data.c_str(), texts[i].x, texts[i].y);
+		}
+		delete gc;
+	}
+
+	wxRect all(size);
+	CopyLayer(background, overlay, all);
+	{
+		wxMemoryDC dc(overlay);
+		wxGraphicsContext *gc = wxGraphicsContext::Create(dc);
+		assert(gc);
+		feedback_area = DrawFeedback(gc);
+		delete gc;
+	}
+
+	CopyLayer(overlay, frame, all);
+	stroke_drawn = 0;
+	stroke_area = wxRect();
+	layers_dirty = false;
+	//Painting covers the whole panel anyway.
+	GrowStroke();
+}
+
+void Canvas::PrepareFeedback() {
+	if(!feedback)
+		return;
+
+	if(feedback_renderers.size() < feedback->items.size()) {
+		//Warm-up, renderers are kept for later strokes.
+		AllocCheck::Exempt exempt;
+		feedback_renderers.resize(feedback->items.size());
+		for(int i=0; i<feedback_renderers.size(); i++) {
+			feedback_renderers[i].Reserve(Feedback::Item::kMaxPens);
+		}
+	}
+	//Pens are made here as they can't be shared with other threads.
+	float starts[Feedback::Item::kMaxPens];
+	const wxPen *pens[Feedback::Item::kMaxPens];
+	for(int i=0; i<feedback->items.size(); i++) {
+		const Feedback::Item &item = feedback->items[i];
+		for(int j=0; j<item.pen_count; j++) {
+			starts[j] = item.pens[j].start;
+			pens[j] = &FeedbackPen(item.pens[j]);
+		}
+		feedback_renderers[i].SetPens(item.pen_count, starts, pens);
+		feedback_renderers[i].SetTransform(item.transform.x, item.transform.y);
 	}
+}
 
-	//Render texts.
-	for(int i=0; i<texts.size(); i++) {
-		dc.DrawText(texts[i].data.c_str(), texts[i].x, texts[i].y);
+const wxPen &Canvas::FeedbackPen(const Feedback::Pen &pen) {
+	//wxPen takes the width as an integer.
+	int width = (int)pen.width;
+	unsigned long rgba = (unsigned long)pen.red<<24 | (unsigned long)pen.green<<16 | pen.blue<<8 | pen.alpha;
+	PenCache::key_type key(rgba, width);
+	PenCache::iterator it = feedback_pens.find(key);
+	if(it == feedback_pens.end()) {
+		//Warm-up, there are only so many colors and widths.
+		AllocCheck::Exempt exempt;
+		wxPen made(wxColor(pen.red, pen.green, pen.blue, pen.alpha), width);
+		it = feedback_pens.insert(std::make_pair(key, made)).first;
 	}
+	return it->second;
+}
+
+wxRect Canvas::DrawFeedback(wxGraphicsContext *gc) {
+	wxRect area;
+	if(!feedback)
+		return area;
+
+	for(int i=0; i<feedback->items.size(); i++) {
+		const Feedback::Item &item = feedback->items[i];
+		float width = 0.0f;
+		for(int j=0; j<item.pen_count; j++) {
+			width = item.pens[j].width > width ? item.pens[j].width : width;
+		}
+		feedback_renderers[i].Render(gc, *item.gesture);
 
-	//Render current gesture.
-	if(cur_gesture) {
-		Gesture::Point anchor = cur_gesture->GetAnchor();
-		cur_gesture->SetTransform(anchor.x, anchor.y);
-		cur_gesture->Render(dc);
+		Gesture::Point lo = item.gesture->GetBoxMin(), hi = item.gesture->GetBoxMax();
+		area.Union(AreaOf(lo.x+item.transform.x, lo.y+item.transform.y, hi.x+item.transform.x, hi.y+item.transform.y,
+			(int)ceil(width/2) + kAreaMargin));
 	}
+
+	gc->SetFont(GetFont(), *wxBLACK);
+	for(int i=0; i<feedback->labels.size(); i++) {
+		const Feedback::Label &label = feedback->labels[i];
+		wxDouble width, height;
+		gc->GetTextExtent(label.text, &width, &height);
+		gc->DrawText(label.text, label.x, label.y);
+		area.Union(AreaOf(label.x, label.y, label.x+width, label.y+height, kAreaMargin));
+	}
+	return area;
+}
+
+void Canvas::CopyLayer(wxBitmap &from, wxBitmap &to, const wxRect &area) {
+	if(area.IsEmpty())
+		return;
+	wxMemoryDC source(from), target(to);
+	target.Blit(area.x, area.y, area.width, area.height, &source, area.x, area.y);
+}
+
+void Canvas::RestoreFrame(const wxRect &area) {
+	CopyLayer(overlay, frame, area);
+	if(!cur_gesture || area.IsEmpty() || !area.Intersects(stroke_area))
+		return;
+
+	//The frame has every point of the stroke, so the whole of it is redrawn, only inside area.
+	wxMemoryDC dc(frame);
+	wxGraphicsContext *gc = wxGraphicsContext::Create(dc);
+	assert(gc);
+	gc->Clip(area.x, area.y, area.width, area.height);
+	stroke_renderer.Render(gc, *cur_gesture);
+	delete gc;
+}
+
+wxRect Canvas::GrowStroke() {
+	if(!cur_gesture || layers_dirty)
+		return wxRect();
+
+	//New segments start from the last point drawn. Simplification may have moved that one since, then its segment is
+	//drawn again from the point before, the old one is within tolerance of the new one.
+	int first = stroke_drawn > 0 ? stroke_drawn-1 : 0;
+	Gesture::Point moved = first < cur_gesture->Size() ? cur_gesture->Get(first) : stroke_tip;
+	if(stroke_drawn > 1 && (moved.x != stroke_tip.x || moved.y != stroke_tip.y))
+		first--;
+	else if(cur_gesture->Size() <= stroke_drawn)
+		return wxRect();
+	Gesture::Point anchor = cur_gesture->GetAnchor();
+	Gesture::Point lo = cur_gesture->Get(first), hi = lo;
+	for(int i=first+1; i<cur_gesture->Size(); i++) {
+		Gesture::Point p = cur_gesture->Get(i);
+		lo.x = p.x < lo.x ? p.x : lo.x;
+		lo.y = p.y < lo.y ? p.y : lo.y;
+		hi.x = p.x > hi.x ? p.x : hi.x;
+		hi.y = p.y > hi.y ? p.y : hi.y;
+	}
+
+	{
+		AllocCheck::Exempt exempt;
+		wxMemoryDC dc(frame);
+		wxGraphicsContext *gc = wxGraphicsContext::Create(dc);
+		assert(gc);
+		stroke_renderer.RenderTail(gc, *cur_gesture, first);
+		delete gc;
+	}
+	stroke_drawn = cur_gesture->Size();
+	stroke_tip = cur_gesture->Get(stroke_drawn-1);
+	wxRect area = AreaOf(lo.x+anchor.x, lo.y+anchor.y, hi.x+anchor.x, hi.y+anchor.y, kAreaMargin);
+	stroke_area.Union(area);
+	return area;
+}
+
+void Canvas::EraseStroke() {
+	wxRect area = stroke_area;
+	stroke_area = wxRect();
+	stroke_drawn = 0;
+	if(layers_dirty || area.IsEmpty())
+		return;
+	RestoreFrame(area);
+	Invalidate(area);
+}
+
+void Canvas::SetFeedback(const Feedback *f) {
+	if(!f && !feedback)
+		return;
+	feedback = f;
+	PrepareFeedback();
+	if(layers_dirty)
+		return;
+
+	TimelineSpan span("Canvas::SetFeedback");
+	//Painting is left to wx, which allocates for it.
+	AllocCheck::Exempt exempt;
+	//Overlay first: where the old feedback was goes back to the background and the new one goes on top.
+	wxRect dirty = feedback_area;
+	CopyLayer(background, overlay, dirty);
+	{
+		wxMemoryDC dc(overlay);
+		wxGraphicsContext *gc = wxGraphicsContext::Create(dc);
+		assert(gc);
+		feedback_area = DrawFeedback(gc);
+		delete gc;
+	}
+	dirty.Union(feedback_area);
+	dirty.Intersect(wxRect(frame.GetSize()));
+	if(dirty.IsEmpty())
+		return;
+	RestoreFrame(dirty);
+	Invalidate(dirty);
+}
+
+void Canvas::ClearCurrentGesture() {
+	delete cur_gesture;
+	cur_gesture = 0;
+	EraseStroke();
 }
 
 void Canvas::OnMouseLeftDown(wxMouseEvent& event) {
+	TimelineSpan span("Canvas::OnMouseLeftDown");
 	mouse_state = DOWN;
-	if(cur_gesture)
-		delete cur_gesture;
+	ClearCurrentGesture();
 	cur_gesture = new Gesture;
+	cur_gesture->Reserve(Gesture::kStrokeReserve);
+	cur_gesture->SetSimplify(Gesture::kStrokeSimplify);
 	cur_gesture->PushBack(event.GetX(), event.GetY());
+	Gesture::Point anchor = cur_gesture->GetAnchor();
+	stroke_renderer.SetTransform(anchor.x, anchor.y);
+	update_pending = false;
+	stroke_coalesced = 0;
 
 	CanvasEvent e(CANVAS_EVENT, CanvasEvent::NEW_GESTURE);
 	e.SetCanvas(this);
 	Publish(e);
-	Refresh();
 }
 
 void Canvas::OnMouseLeftUp(wxMouseEvent &event) {
+	TimelineSpan span("Canvas::OnMouseLeftUp");
 	mouse_state = UP;
+	//Completing covers the moves of the last frame as well.
+	if(update_pending) {
+		update_pending = false;
+		coalesced++;
+		stroke_coalesced++;
+	}
+	Metrics::Record(Metrics::COALESCED_PER_STROKE, stroke_coalesced);
 
+	//Subscribers take the stroke and the feedback off the canvas, @see ClearCurrentGesture().
 	CanvasEvent e(CANVAS_EVENT, CanvasEvent::COMPLETE_GESTURE);
 	e.SetCanvas(this);
 	Publish(e);
-
-	Refresh();
 }
 
 void Canvas::OnMouseMove(wxMouseEvent& event) {
+	TimelineSpan span("Canvas::OnMouseMove");
 
 	//Stub
 	switch(mouse_state) {
 	case DOWN:
 		{
+			if(frame_rate > 0) {
+				//The next frame publishes and draws it, along with any other move until then.
+				AllocCheck check(cur_gesture->Size() < Gesture::kStrokeReserve);
+				cur_gesture->PushBack(event.GetX(), event.GetY());
+				if(update_pending) {
+					coalesced++;
+					stroke_coalesced++;
+				}
+				update_pending = true;
+				ScheduleFrame();
+				break;
+			}
+
+			//Appending, everything subscribers do about it and drawing the stroke stay off the heap, but for wx itself.
+			AllocCheck check(cur_gesture->Size() < Gesture::kStrokeReserve);
 			int x = event.GetX(), y = event.GetY();
 			cur_gesture->PushBack(x, y);
-			
+
 			CanvasEvent e(CANVAS_EVENT, CanvasEvent::UPDATE_GESTURE);
 			e.SetCanvas(this);
 			Publish(e);
 
-			Refresh();
+			//Only the new segments are drawn and repainted.
+			wxRect area = GrowStroke();
+			if(!area.IsEmpty()) {
+				AllocCheck::Exempt exempt;
+				RefreshRect(area, false);
+			}
 		}
 		break;
 	default:
@@ -90,26 +400,37 @@ void Canvas::Unsubscribe(wxEvtHandler *client) {
 	subscriptions.erase(client);
 }
 
-void Canvas::Publish(const wxEvent &event) {
+void Canvas::Publish(wxEvent &event) {
+	TimelineSpan span("Canvas::Publish");
+	//Subscribers live on the UI thread as well, so the event is handled right away instead of posting a heap copy
+	//per subscriber per mouse move. The order of events is the same either way.
 	for(Subscriptions::iterator it=subscriptions.begin(); it!=subscriptions.end(); it++) {
-		wxPostEvent(*it, event);
+		(*it)->SafelyProcessEvent(event);
 	}
 }
 
 void Canvas::ClearGesture() {
+	if(gestures.empty())
+		return;
 	gestures.clear();
+	InvalidateLayers();
 }
 
-void Canvas::DrawGeture(Gesture *g) {
-	gestures.push_back(g);
+void Canvas::DrawGeture(Gesture *g, const GestureRenderer &renderer) {
+	gestures.push_back(Drawn(g, renderer));
+	InvalidateLayers();
 }
 
 void Canvas::ClearText() {
+	if(texts.empty())
+		return;
 	texts.clear();
+	InvalidateLayers();
 }
 
 void Canvas::DrawText(std::string data, int x, int y) {
 	texts.push_back(Text(data, x, y));
+	InvalidateLayers();
 }
 
 //Event define
@@ -117,9 +438,11 @@ wxDEFINE_EVENT(CANVAS_EVENT, CanvasEvent);
 
 BEGIN_EVENT_TABLE(Canvas, wxPanel)
 	EVT_PAINT(Canvas::PaintEvent)
+	EVT_SIZE(Canvas::OnSize)
 	EVT_LEFT_DOWN(Canvas::OnMouseLeftDown)
 	EVT_LEFT_UP(Canvas::OnMouseLeftUp)
 	EVT_MOTION(Canvas::OnMouseMove)
+	EVT_TIMER(wxID_ANY, Canvas::OnFrame)
 END_EVENT_TABLE()
 
 CanvasEvent::CanvasEvent(wxEventType type, int id) : wxCommandEvent(type, id) {
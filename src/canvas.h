@@ -6,12 +6,18 @@
 	#include <wx/wx.h>
 #endif
 
+#include "feedback.h"
+#include "gesture_renderer.h"
+
+#include <map>
 #include <set>
 #include <vector>
 #include <string>
+#include <utility>
 
 class Gesture;
 class Canvas;
+class wxGraphicsContext;
 
 //Some event.
 class CanvasEvent;
@@ -54,8 +60,23 @@ typedef void (wxEvtHandler::*CanvasEventFunction)(CanvasEvent &);
  * The Canvas also implement some event, @see CanvasEvent. The intention is to decouple 
  * the display of the new gesture and anything else, which could be drawing other stuffs and log 
  * the udpate of new gesture.
+ *
+ * Drawing is retained in three layers, each a bitmap the size of the panel:
+ *		background		gestures and texts, rebuilt as a whole when they change or the panel is resized
+ *		overlay			background plus the feedback, where the old feedback was is restored from the background
+ *						and the new one drawn on top when it changes
+ *		frame			overlay plus the current stroke, which only gets its new segments drawn as it grows
+ * Every change refreshes the rectangle it touched, and painting only copies the frame over the update region, so
+ * the cost of a mouse move follows the few pixels it changes rather than the size of the window.
+ *
+ * Updates are paced by a frame timer, @see SetFrameRate(). A mouse move only appends to the current stroke, the
+ * next frame then publishes one UPDATE_GESTURE for every move since the last one and refreshes every rectangle
+ * touched in between. So a mouse polled at 1000Hz costs one recognition round and one repaint per frame.
  */
 class Canvas : public wxPanel {
+public:
+	enum {kDefaultFrameRate = 60};
+
 private:
 	struct Text {
 		std::string data;
@@ -68,13 +89,23 @@ private:
 		Text() {}
 	};
 
+	struct Drawn {
+		Gesture *gesture;
+		GestureRenderer renderer;
+
+		Drawn(Gesture *_g, const GestureRenderer &_r) : gesture(_g), renderer(_r) {}
+	};
+
 private:
 	typedef std::set<wxEvtHandler  *> Subscriptions;
-	typedef std::vector<Gesture *> Gestures;
+	typedef std::vector<Drawn> Gestures;
 	typedef std::vector<Text> Texts;
+	//By rgba and width.
+	typedef std::map<std::pair<unsigned long, int>, wxPen> PenCache;
 
 public :
 	Canvas(wxFrame *parent);
+	~Canvas();
 
 	void OnMouseLeftUp(wxMouseEvent &event);
 	void OnMouseLeftDown(wxMouseEvent &event);
@@ -82,7 +113,8 @@ public :
 	void OnMouseMove(wxMouseEvent &event);
 
 	Gesture *GetCurrentGesture() const { return cur_gesture; }
-	void ClearCurrentGesture() { cur_gesture = 0; }
+	//The canvas owns the stroke, it is deleted here.
+	void ClearCurrentGesture();
 
 	/**
 	  * Subscribe the event published by canvas for client.
@@ -91,19 +123,57 @@ public :
 	void Unsubscribe(wxEvtHandler *client);
 
 	void ClearGesture();
-	void DrawGeture(Gesture *g);
+	//Not owned, drawn with the pens and transform of renderer.
+	void DrawGeture(Gesture *g, const GestureRenderer &renderer = GestureRenderer());
 
 	void ClearText();
 	void DrawText(std::string data, int x, int y);
 
+	/**
+	 * Draw feedback of candidates on top of gestures and texts, 0 for nothing. Not owned, it must stay unchanged until
+	 * replaced, as the layers may have to be rebuilt from it. The canvas refreshes what changes by itself.
+	 */
+	void SetFeedback(const Feedback *f);
+
+	//Frames per second updates and repaints are paced at, 0 to publish and refresh on every mouse move.
+	void SetFrameRate(int rate);
+	//Mouse moves that did not get an UPDATE_GESTURE of their own.
+	long GetCoalesced() const { return coalesced; }
+
 private:
 	enum MouseState {DOWN, UP};
 
 private:
 	void PaintEvent(wxPaintEvent &evt);
-	void Publish(const wxEvent &event);
+	void OnSize(wxSizeEvent &event);
+	void OnFrame(wxTimerEvent &event);
+	void Publish(wxEvent &event);
 	DECLARE_EVENT_TABLE()
 
+	//Refresh area, right away or on the next frame.
+	void Invalidate(const wxRect &area);
+	//Start the frame timer, unless it is running already.
+	void ScheduleFrame();
+
+	/****************Layers.****************/
+	//Gestures or texts changed, everything is rebuilt on the next paint.
+	void InvalidateLayers();
+	void RebuildLayers();
+	//Set the pens and placement of the feedback renderers, off the heap once the pens of every color are made.
+	void PrepareFeedback();
+	//wxPen allocates, so the feedback gets one per color and width, made the first time it shows up.
+	const wxPen &FeedbackPen(const Feedback::Pen &pen);
+	//Draw feedback on the overlay as prepared, return the area it covers.
+	wxRect DrawFeedback(wxGraphicsContext *gc);
+	//Copy area of from over to. Both must be of the panel size.
+	static void CopyLayer(wxBitmap &from, wxBitmap &to, const wxRect &area);
+	//Restore area of the frame from the overlay, with the part of the current stroke inside it.
+	void RestoreFrame(const wxRect &area);
+	//Draw the points of the current stroke the frame does not have yet, return the area they cover.
+	wxRect GrowStroke();
+	//Take the current stroke off the frame, before it is replaced or dropped.
+	void EraseStroke();
+
 private:
 	MouseState mouse_state;
 	Gesture *cur_gesture;
@@ -111,6 +181,24 @@ private:
 
 	Gestures gestures;
 	Texts texts;
+	const Feedback *feedback;
+	std::vector<GestureRenderer> feedback_renderers;		//One per feedback item, kept for their paths.
+	PenCache feedback_pens;		//A few candidate colors, each in a few widths.
+	GestureRenderer stroke_renderer;
+
+	wxBitmap background, overlay, frame;
+	bool layers_dirty;			//Rebuild everything on the next paint.
+	wxRect feedback_area;		//Covered by the feedback on the overlay.
+	wxRect stroke_area;			//Covered by the current stroke on the frame.
+	int stroke_drawn;			//Points of the current stroke on the frame.
+	Gesture::Point stroke_tip;	//Last of them, as drawn.
+
+	wxTimer frame_timer;		//One shot, started by whatever needs the next frame.
+	int frame_rate;
+	bool update_pending;		//The current stroke grew since its last UPDATE_GESTURE.
+	wxRect pending_area;		//To refresh on the next frame.
+	long coalesced;
+	int stroke_coalesced;		//Of the current stroke, @see Metrics::COALESCED_PER_STROKE.
 };
 
 #endif			//CANVAS_H_
\ No newline at end of file
@@ -0,0 +1,63 @@
+#ifndef FEEDBACK_H_
+#define FEEDBACK_H_
+
+#include "gesture.h"
+
+#include <string>
+#include <vector>
+
+#include <string.h>
+
+/**
+ * What to draw for the candidates of a stroke: pens and placement of each template, and the labels, @see FeedForward.
+ *
+ * It is produced off the UI thread, so it only holds plain values. wxPen and friends are reference counted without
+ * locking and are only built on the UI thread when painting. Templates are shared read only.
+ * Items and labels are fixed size, so refilling a Feedback whose vectors have room never allocates.
+ */
+struct Feedback {
+	struct Pen {
+		float start;			//Arc length parameter the pen starts from.
+		unsigned char red, green, blue, alpha;
+		float width;
+
+		Pen() {}
+		Pen(float _start, unsigned char _red, unsigned char _green, unsigned char _blue, unsigned char _alpha, float _width)
+			: start(_start), red(_red), green(_green), blue(_blue), alpha(_alpha), width(_width) {}
+	};
+
+	struct Item {
+		enum {kMaxPens = 3};		//Stroke, feedforward and its fading end.
+
+		const Gesture *gesture;
+		int index;					//Of gesture in the templates of the stroke.
+		float falloff;				//Of the candidate, it is ranked by.
+		Gesture::Point transform;
+		Pen pens[kMaxPens];			//Sorted by start, the first one starting at 0.0f.
+		int pen_count;
+
+		Item() : gesture(0), index(-1), falloff(0.0f), pen_count(0) {}
+	};
+
+	struct Label {
+		enum {kMaxText = 64};
+
+		char text[kMaxText];		//Truncated beyond kMaxText-1 characters, it is only for display.
+		float x, y;
+
+		Label(const std::string &_text, float _x, float _y) : x(_x), y(_y) {
+			size_t size = _text.size() < kMaxText ? _text.size() : kMaxText-1;
+			memcpy(text, _text.data(), size);
+			text[size] = '\0';
+		}
+	};
+
+	int stroke;			//Id of the stroke it was computed for.
+	int points;			//Points of that stroke it covers.
+	std::vector<Item> items;
+	std::vector<Label> labels;
+
+	Feedback() : stroke(-1), points(0) {}
+};
+
+#endif			//FEEDBACK_H_
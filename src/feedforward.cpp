@@ -0,0 +1,136 @@
+#include "feedforward.h"
+#include "gesture.h"
+#include "recognizer.h"
+#include "metrics.h"
+
+#include <assert.h>
+#include <math.h>
+
+//Things that are configurable.
+static const float kFeedForwardLength = 80.0f;
+static const int kInitialWidth = 10;
+static const unsigned char kTransparency =  20;
+
+FeedForward::FeedForward() {
+	ranked.reserve(kMaxCandidates);
+	shown.reserve(kMaxCandidates);
+	next_shown.reserve(kMaxCandidates);
+}
+
+//Same as GestureRenderer::SetPen.
+static void SetPen(Feedback::Item *item, const Feedback::Pen &pen) {
+	if(pen.start == 0.0f) {
+		item->pens[0] = pen;
+		return;
+	}
+
+	assert(pen.start>0.0f && pen.start<1.0f);
+	assert(item->pen_count < Feedback::Item::kMaxPens);
+	int i = item->pen_count++;
+	for(; i>0 && item->pens[i-1].start > pen.start; i--) {
+		item->pens[i] = item->pens[i-1];
+	}
+	item->pens[i] = pen;
+}
+
+//Hues evenly spread around the color wheel, one per slot, at full saturation and value as wxImage::HSVtoRGB gives.
+static void CandidateColor(int slot, unsigned char *red, unsigned char *green, unsigned char *blue) {
+	double hue = (double)slot/FeedForward::kMaxCandidates*6.0;
+	int sector = (int)floor(hue);
+	double f = hue-sector;
+	double r, g, b;
+	switch(sector) {
+	case 0: r = 1.0; g = f; b = 0.0; break;
+	case 1: r = 1.0-f; g = 1.0; b = 0.0; break;
+	case 2: r = 0.0; g = 1.0; b = f; break;
+	case 3: r = 0.0; g = 1.0-f; b = 1.0; break;
+	case 4: r = f; g = 0.0; b = 1.0; break;
+	default: r = 1.0; g = 0.0; b = 1.0-f; break;
+	}
+	*red = (unsigned char)(r*255.0);
+	*green = (unsigned char)(g*255.0);
+	*blue = (unsigned char)(b*255.0);
+}
+
+void FeedForward::Present(Recognizer &recognizer, const Gesture &stroke, int stroke_id, const Gestures &templates,
+							Feedback *feedback) {
+	ScopedTimer timer(Metrics::PRESENT);
+	recognizer.Rank(kMaxCandidates, &ranked);
+
+	//A candidate keeps its color as long as it stays on display, new ones take a free slot.
+	std::vector<Shown> &next = next_shown;
+	next.clear();
+	bool used[kMaxCandidates] = {false};
+	for(int i=0; i<ranked.size(); i++) {
+		next.push_back(Shown(ranked[i], -1));
+		for(int j=0; j<shown.size(); j++) {
+			if(shown[j].index == ranked[i]) {
+				next[i].color = shown[j].color;
+				used[next[i].color] = true;
+				break;
+			}
+		}
+	}
+	int slot = 0;
+	for(int i=0; i<next.size(); i++) {
+		if(next[i].color != -1)
+			continue;
+		while(used[slot])
+			slot++;
+		next[i].color = slot;
+		used[slot] = true;
+	}
+	shown.swap(next);
+
+	//Setup gestures to be displayed.
+	const Gesture *c = &stroke;
+	Gesture::Point anchor = c->GetAnchor();
+	feedback->stroke = stroke_id;
+	feedback->points = stroke.Size();
+	feedback->items.resize(shown.size());
+	feedback->labels.clear();
+	for(int k=0; k<shown.size(); k++) {
+		int i = shown[k].index;
+		unsigned char red, green, blue;
+		CandidateColor(shown[k].color, &red, &green, &blue);
+		const Gesture *cur = templates[i].second;
+		float falloff = recognizer.Falloff(i);
+		Feedback::Item &item = feedback->items[k];
+		item.gesture = cur;
+		item.index = i;
+		item.falloff = falloff;
+		item.pens[0] = Feedback::Pen(0.0f, red, green, blue, 255, 0.0f);
+		item.pen_count = 1;
+
+		float ff_start = c->Length()/cur->Length();
+		ff_start = ff_start > 1.0f ? 1.0f : ff_start;
+		if(ff_start != 1.0f) {
+			SetPen(&item, Feedback::Pen(ff_start, red, green, blue, 255, kInitialWidth * falloff));
+		}
+
+		float ff_end = ff_start + kFeedForwardLength/cur->Length();
+		ff_end = ff_end > 1.0f ? 1.0f : ff_end;
+
+		if(ff_end != 1.0f) {
+			SetPen(&item, Feedback::Pen(ff_end, red, green, blue, kTransparency, kInitialWidth * falloff));
+		}
+
+		//Set transform
+		Gesture::Point transform =  c->Back();
+		float p = c->Length()/cur->Length();
+		p = p >1.0f ? 1.0f : p;
+		Gesture::Point temp = cur->Sample(p);
+		transform.x = -temp.x + transform.x + anchor.x;
+		transform.y = -temp.y + transform.y + anchor.y;
+		item.transform = transform;
+
+		//Try to draw candiates names.
+		if(falloff == 0.0f)
+			continue;
+		else {
+			Gesture::Point p = cur->Sample(ff_end);
+			feedback->labels.push_back(Feedback::Label(templates[i].first, p.x + transform.x, p.y + transform.y));
+		}
+	}
+	Metrics::Record(Metrics::CANDIDATES, shown.size());
+}
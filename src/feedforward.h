@@ -0,0 +1,55 @@
+#ifndef FEEDFORWARD_H_
+#define FEEDFORWARD_H_
+
+#include "feedback.h"
+
+#include <string>
+#include <vector>
+#include <utility>
+
+class Gesture;
+class Recognizer;
+
+/**
+ * Turns the ranking of a Recognizer into a Feedback: the best candidates of the stroke being drawn, each placed where
+ * the stroke ends, with its pens for the part already drawn, the feedforward ahead and its fading end, and its name.
+ *
+ * Used by RecognitionStage for the canvas and by the recognition server for its clients, so both present the same.
+ * No wxWidgets, colors are plain values. A candidate keeps its color as long as it stays on display.
+ * Everything is sized up front, so presenting does not allocate.
+ */
+class FeedForward {
+public:
+	typedef std::vector<std::pair<std::string, const Gesture *> > Gestures;
+
+	enum {kMaxCandidates = 5};			//Number of candidates on display.
+
+private:
+	//A candidate keeps its color slot as long as it stays on display.
+	struct Shown {
+		int index;
+		int color;
+
+		Shown(int _index, int _color) : index(_index), color(_color) {}
+	};
+
+public:
+	FeedForward();
+
+	//A new stroke, candidates on display give up their colors.
+	void Begin() { shown.clear(); }
+	/**
+	 * Rank the candidates of recognizer and fill feedback for stroke, which recognizer is tracking against templates.
+	 * feedback should have room for kMaxCandidates items and labels, otherwise it allocates.
+	 */
+	void Present(Recognizer &recognizer, const Gesture &stroke, int stroke_id, const Gestures &templates,
+					Feedback *feedback);
+
+private:
+	std::vector<Shown> shown;
+	//Scratch of Present.
+	std::vector<int> ranked;
+	std::vector<Shown> next_shown;
+};
+
+#endif			//FEEDFORWARD_H_
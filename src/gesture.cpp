@@ -1,37 +1,121 @@
 #include "gesture.h"
+#include "gesture_kernels.h"
+#include "metrics.h"
+#include "timeline.h"
 
+#include <assert.h>
 #include <math.h>
+#include <limits>
 
-#include <wx/wxprec.h>
-#ifndef WX_PRECOMP
-	#include <wx/wx.h>
+#ifdef _MSC_VER
+	#include <intrin.h>
+	#define ATOMIC_INCREMENT(p) _InterlockedIncrement(p)
+#else
+	#define ATOMIC_INCREMENT(p) __sync_add_and_fetch(p, 1)
 #endif
 
-#include <wx/graphics.h>
+//Last revision taken by any gesture, gestures change on every thread.
+static volatile long revisions = 0;
+
+Gesture::Gesture() : revision(ATOMIC_INCREMENT(&revisions)), descriptor(0), own_descriptor(false),
+		cone_open(true), cone_base(0.0f), cone_low(0.0f), cone_high(0.0f), cone_reach(0.0f), simplified(0) {
 
-Gesture::Gesture() : need_reparam(false) {
-	pens.push_back(PenConfig(0.0f, wxPen(wxColor(0, 0, 0), 1)));
 }
 Gesture::~Gesture() {
-
+	DropDescriptor();
 }
 
-Gesture::Gesture(const Gesture &rhs) {
+Gesture::Gesture(const Gesture &rhs) : revision(0), descriptor(0), own_descriptor(false),
+		cone_open(true), cone_base(0.0f), cone_low(0.0f), cone_high(0.0f), cone_reach(0.0f), simplified(0) {
 	this->operator=(rhs);
 }
 
+void Gesture::Changed() {
+	revision = ATOMIC_INCREMENT(&revisions);
+}
+
 void Gesture::operator=(const Gesture &rhs) {
-	this->points = rhs.points;
-	this->need_reparam = true;
+	this->xs = rhs.xs;
+	this->ys = rhs.ys;
+	this->lengths = rhs.lengths;
+	this->anchor = rhs.anchor;
+	this->box_min = rhs.box_min;
+	this->box_max = rhs.box_max;
+	this->simplify = rhs.simplify;
+	this->cone_open = rhs.cone_open;
+	this->cone_base = rhs.cone_base;
+	this->cone_low = rhs.cone_low;
+	this->cone_high = rhs.cone_high;
+	this->cone_reach = rhs.cone_reach;
+	this->simplified = rhs.simplified;
+	Changed();
+	DropDescriptor();
+	if(rhs.descriptor) {
+		descriptor = new Descriptor(*rhs.descriptor);
+		own_descriptor = true;
+	}
 }
 
-const static int kMaxSampleSize = 100;
-const static float kErrorClamp = 5.0f;
+const float Gesture::kErrorClamp = 5.0f;
+//Half a pixel is below what the mouse can tell apart, and a 20 degree turn keeps corners sharp.
+const Gesture::Simplify Gesture::kStrokeSimplify(0.5f, 0.35f);
+
+void Gesture::DropDescriptor() {
+	if(own_descriptor)
+		delete descriptor;
+	descriptor = 0;
+	own_descriptor = false;
+}
+
+void Gesture::BuildDescriptor() {
+	DropDescriptor();
+	if(xs.size() <= 1)
+		return;
+	BuildDescriptor(new Descriptor);
+	own_descriptor = true;
+}
+
+void Gesture::BuildDescriptor(Descriptor *storage) {
+	DropDescriptor();
+	if(xs.size() <= 1)
+		return;
+
+	descriptor = storage;
+	descriptor->length = Length();
+	for(int i=0; i<Descriptor::kSize; i++) {
+		descriptor->lengths[i] = descriptor->length*i/kMaxSampleSize;
+	}
+	int cursor = 0;
+	SampleLengths(descriptor->lengths, Descriptor::kSize, descriptor->xs, descriptor->ys, &cursor);
+
+	//Coarse level and prefix bounding boxes.
+	Point box_min(descriptor->xs[0], descriptor->ys[0]), box_max = box_min;
+	for(int i=0; i<Descriptor::kSize; i++) {
+		box_min.x = descriptor->xs[i] < box_min.x ? descriptor->xs[i] : box_min.x;
+		box_min.y = descriptor->ys[i] < box_min.y ? descriptor->ys[i] : box_min.y;
+		box_max.x = descriptor->xs[i] > box_max.x ? descriptor->xs[i] : box_max.x;
+		box_max.y = descriptor->ys[i] > box_max.y ? descriptor->ys[i] : box_max.y;
+		if(i%Descriptor::kCoarseStep == 0) {
+			int k = i/Descriptor::kCoarseStep;
+			descriptor->coarse_xs[k] = descriptor->xs[i];
+			descriptor->coarse_ys[k] = descriptor->ys[i];
+			descriptor->coarse_lengths[k] = descriptor->lengths[i];
+			descriptor->box_min[k] = box_min;
+			descriptor->box_max[k] = box_max;
+		}
+	}
+}
 
 float Gesture::Compare(const Gesture& rhs) const {
 	if(rhs.Size() <= 1 || Size() <= 1)
 		return 0.0f;
 
+	if(rhs.descriptor)
+		return Compare(*rhs.descriptor, std::numeric_limits<float>::infinity());
+	if(descriptor)
+		return rhs.Compare(*descriptor, std::numeric_limits<float>::infinity());
+
+	ScopedTimer timer(Metrics::COMPARE);
 	float left_l = Length(), right_l = rhs.Length();
 	const Gesture *left = this, *right = &rhs;
 	
@@ -45,157 +129,351 @@ float Gesture::Compare(const Gesture& rhs) const {
 		right_l = dummy;
 	}
 
-	std::vector<Point> left_sample, right_sample;
 	int sample_size = left_l/right_l*kMaxSampleSize;
 	sample_size = sample_size < 2 ? 2 : sample_size;
-	left->UniformSample(sample_size, &left_sample, 0.0f, 1.0f);
-	right->UniformSample(sample_size, &right_sample, 0.0f, left_l/right_l);
+	//Layout: left x, left y, right x, right y. left_l <= right_l so there are at most kMaxSampleSize samples.
+	float samples[kMaxSampleSize*4];
+	float *left_x = samples, *left_y = left_x+sample_size;
+	float *right_x = left_y+sample_size, *right_y = right_x+sample_size;
+	left->UniformSample(sample_size, left_x, left_y, 0.0f, 1.0f);
+	right->UniformSample(sample_size, right_x, right_y, 0.0f, left_l/right_l);
 	
-	float error = 0.0f;
-	for(int i=0; i<sample_size; i++) {
-		float  d = Point::SquareDistance(left_sample[i], right_sample[i]);
-		if(d > kErrorClamp)
-			error += d;
-	}
+	float error = gesture_kernels::ClampedSquareError(left_x, left_y, right_x, right_y, sample_size, kErrorClamp, 0.0f);
 
 	return sqrt(error/sample_size);
 }
 
-void Gesture::Render(wxMemoryDC &dc) const {
-	if(points.empty())
-		return;
-	Parameterization();
-
-	wxGraphicsContext *gc = wxGraphicsContext::Create(dc);
-	assert(gc);
-
-	//Gather index for each pen.
-	std::vector<int> start_indices;
-	//Assume the interval of piecewise function is small.
-	int pen_index = 1;
-	start_indices.push_back(0);
-	for(int i=0; i<points.size()-1; i++) {
-		float p = metas[i+1].p;
-		if(pen_index >= pens.size())
-			break;
-		if(p > pens[pen_index].p) {
-			start_indices.push_back(i);
-			pen_index++;
-		}
-	}
+float Gesture::Compare(const Gesture& rhs, float bound) const {
+	if(rhs.Size() <= 1 || Size() <= 1)
+		return 0.0f;
 
-	assert(start_indices.size() == pens.size());
+	if(rhs.descriptor)
+		return Compare(*rhs.descriptor, bound);
+	if(descriptor)
+		return rhs.Compare(*descriptor, bound);
+	return Compare(rhs);
+}
 
-	for(int i=0; i<start_indices.size() - 1; i++) {
-		if(pens[i].pen.GetWidth() == 0)
-			continue;
+float Gesture::BoxBound(const Gesture& rhs) const {
+	if(!rhs.descriptor || rhs.Size() <= 1 || Size() <= 1)
+		return 0.0f;
+
+	//Template samples used by Compare all lie in the coarse prefix box covering them,
+	//this gesture's samples lie on its own polyline.
+	int m = PrefixSize(*rhs.descriptor);
+	m = m < 1 ? 1 : m;
+	int k = (m+Descriptor::kCoarseStep-1)/Descriptor::kCoarseStep;
+	const Point &t_min = rhs.descriptor->box_min[k], &t_max = rhs.descriptor->box_max[k];
+
+	float gap_x = 0.0f, gap_y = 0.0f;
+	if(box_min.x > t_max.x)
+		gap_x = box_min.x - t_max.x;
+	else if(t_min.x > box_max.x)
+		gap_x = t_min.x - box_max.x;
+	if(box_min.y > t_max.y)
+		gap_y = box_min.y - t_max.y;
+	else if(t_min.y > box_max.y)
+		gap_y = t_min.y - box_max.y;
+
+	//Every sample pair is at least gap apart, which only counts if it survives the clamp.
+	float gap = gap_x*gap_x + gap_y*gap_y;
+	return gap > kErrorClamp ? sqrt(gap) : 0.0f;
+}
+
+float Gesture::CoarseBound(const Gesture& rhs) const {
+	if(!rhs.descriptor || rhs.Size() <= 1 || Size() <= 1)
+		return 0.0f;
+
+	const Descriptor &d = *rhs.descriptor;
+	int m = PrefixSize(d);
+	if(m < 1)
+		return 0.0f;
+
+	//The coarse samples are a subset of the samples Compare takes, so their sum is a part of the full sum.
+	int coarse_size = m/Descriptor::kCoarseStep+1;
+	float left_x[Descriptor::kCoarseSize], left_y[Descriptor::kCoarseSize];
+	int cursor = 0;
+	SampleLengths(d.coarse_lengths, coarse_size, left_x, left_y, &cursor);
+	float error = gesture_kernels::ClampedSquareError(left_x, left_y, d.coarse_xs, d.coarse_ys, coarse_size, kErrorClamp, 0.0f);
+	return sqrt(error/(m+1));
+}
 
-		int p_start = start_indices[i];
-		int p_end = start_indices[i+1];
-		gc->SetPen(pens[i].pen);
-		wxGraphicsPath path = gc->CreatePath();
-		for(int j=p_start; j<p_end; j++) {
-			path.MoveToPoint(points[j].x+transform.x, points[j].y+transform.y);
-			path.AddLineToPoint(points[j+1].x+transform.x, points[j+1].y+transform.y);
+int Gesture::PrefixSize(const Descriptor &rhs) const {
+	int m = (int)(Length()/rhs.length*kMaxSampleSize);
+	return m > kMaxSampleSize ? kMaxSampleSize : m;
+}
+
+float Gesture::Compare(const Descriptor &rhs, float bound) const {
+	ScopedTimer timer(Metrics::COMPARE);
+	//Both sides are aligned on arc length: sample i of the template sits at rhs.lengths[i],
+	//so take the template prefix as long as this gesture and sample this gesture at the same lengths.
+	int m = PrefixSize(rhs);
+
+	float error = 0.0f;
+	int sample_size = m+1;
+	if(m < 1) {
+		//Shorter than one interval, compare the end points like resampling with 2 samples does.
+		float f = Length()/rhs.length*kMaxSampleSize;
+		Point end = Back();
+		Point templ(rhs.xs[0]*(1-f) + rhs.xs[1]*f, rhs.ys[0]*(1-f) + rhs.ys[1]*f);
+		float d = Point::SquareDistance(Point(xs[0], ys[0]), Point(rhs.xs[0], rhs.ys[0]));
+		error += d > kErrorClamp ? d : 0.0f;
+		d = Point::SquareDistance(end, templ);
+		error += d > kErrorClamp ? d : 0.0f;
+		sample_size = 2;
+	}
+	else {
+		//Go chunk by chunk, and give up once the sum alone already exceeds the bound.
+		const int kChunk = 32;
+		float limit = bound*bound*sample_size;
+		float left_x[kChunk], left_y[kChunk];
+		int cursor = 0;
+		for(int base=0; base<sample_size; base+=kChunk) {
+			int size = sample_size-base < kChunk ? sample_size-base : kChunk;
+			SampleLengths(rhs.lengths+base, size, left_x, left_y, &cursor);
+			error = gesture_kernels::ClampedSquareError(left_x, left_y, rhs.xs+base, rhs.ys+base, size, kErrorClamp, error);
+			if(error > limit)
+				break;
 		}
-		gc->StrokePath(path);
 	}
 
+	return sqrt(error/sample_size);
+}
 
-	if(pens.back().pen.GetWidth() != 0) {
-		gc->SetPen(pens.back().pen);
-		wxGraphicsPath path = gc->CreatePath();
-		for(int i=start_indices.back(); i<points.size()-1; i++) {
-			path.MoveToPoint(points[i].x+transform.x, points[i].y+transform.y);
-			path.AddLineToPoint(points[i+1].x+transform.x, points[i+1].y+transform.y);
-		}
-		gc->StrokePath(path);
+void Gesture::PushBack(float x, float y) {
+	DropDescriptor();
+	Changed();
+	if(xs.empty()) {
+		anchor.x = x;
+		anchor.y = y;
+	}
+
+	//Transform according to the first element.
+	x -= anchor.x;
+	y -= anchor.y;
+	if(!xs.empty() && xs.back() == x && ys.back() == y)
+		return;
+
+	if(simplify.distance > 0.0f && xs.size() >= 2 && Supersede(x, y)) {
+		int n = xs.size();
+		xs[n-1] = x;
+		ys[n-1] = y;
+		UpdateBox(x, y);
+		float dx = x-xs[n-2], dy = y-ys[n-2];
+		lengths[n-1] = lengths[n-2] + sqrt(dx*dx + dy*dy);
+		simplified++;
+		return;
+	}
+	//The last point stays, the cone starts over from it.
+	cone_open = true;
+	cone_reach = 0.0f;
+
+	xs.push_back(x);
+	ys.push_back(y);
+	UpdateBox(x, y);
+	//Keep the arc length up to date, so appending is O(1) instead of reparameterizing the whole gesture.
+	if(lengths.empty()) {
+		lengths.push_back(0.0f);
+	}
+	else {
+		int n = xs.size();
+		float dx = xs[n-1]-xs[n-2], dy = ys[n-1]-ys[n-2];
+		lengths.push_back(lengths.back() + sqrt(dx*dx + dy*dy));
 	}
+}
 
-	delete gc;
+//Angle in (-pi, pi].
+static float WrapAngle(float a) {
+	const float kPi = 3.14159265f;
+	while(a > kPi)
+		a -= 2.0f*kPi;
+	while(a <= -kPi)
+		a += 2.0f*kPi;
+	return a;
 }
 
-void Gesture::ClearPens() {
-	pens.erase(pens.begin()+1, pens.end());
+bool Gesture::Supersede(float x, float y) {
+	//Segment from a, the point before the last, must pass within distance of the last point and every one dropped
+	//before it. From a that bounds the direction to a cone, and the segment must reach as far as they do.
+	int n = xs.size();
+	float ax = xs[n-2], ay = ys[n-2];
+	float bx = xs[n-1]-ax, by = ys[n-1]-ay;
+	float b_reach = sqrt(bx*bx + by*by);
+	bool open = cone_open;
+	float base = cone_base, low = cone_low, high = cone_high;
+	float reach = b_reach > cone_reach ? b_reach : cone_reach;
+	//Closer than distance to a, any direction will do.
+	if(b_reach > simplify.distance) {
+		float width = asin(simplify.distance/b_reach);
+		width = width < simplify.angle ? width : simplify.angle;
+		float direction = atan2(by, bx);
+		if(open) {
+			open = false;
+			base = direction;
+			low = -width;
+			high = width;
+		}
+		else {
+			float offset = WrapAngle(direction-base);
+			low = offset-width > low ? offset-width : low;
+			high = offset+width < high ? offset+width : high;
+			if(low > high)
+				return false;
+		}
+	}
+
+	if(!open) {
+		float px = x-ax, py = y-ay;
+		if(px*px + py*py < reach*reach)
+			return false;
+		float offset = WrapAngle((float)atan2(py, px)-base);
+		if(offset < low || offset > high)
+			return false;
+	}
+	cone_open = open;
+	cone_base = base;
+	cone_low = low;
+	cone_high = high;
+	cone_reach = reach;
+	return true;
 }
 
-void Gesture::SetPen(float start, const wxPen& pen) {
-	//Just do linear search here.
-	if(start == 0.0f) {
-		pens[0].pen = pen;
+void Gesture::Append(const float *x, const float *y, int n) {
+	if(n <= 0)
 		return;
+	DropDescriptor();
+	Changed();
+	cone_open = true;
+	cone_reach = 0.0f;
+	if(xs.empty()) {
+		anchor.x = x[0];
+		anchor.y = y[0];
 	}
 
-	assert(start>0.0f && start<1.0f);
-	for(int i=0; i<pens.size(); i++) {
-		if(pens[i].p  > start) {
-			pens.insert(pens.begin()+i, PenConfig(start, pen));
-			return;
+	//Same as calling PushBack on each point, but the arc length of the new points is computed in one pass.
+	//Room for all of them is made up front and trimmed afterwards, which saves growing the arrays point by point.
+	int first = xs.size();
+	xs.resize(first+n);
+	ys.resize(first+n);
+	float *out_x = &xs[0], *out_y = &ys[0];
+	int size = first;
+	for(int i=0; i<n; i++) {
+		float cur_x = x[i] - anchor.x, cur_y = y[i] - anchor.y;
+		if(size > 0 && out_x[size-1] == cur_x && out_y[size-1] == cur_y)
+			continue;
+		out_x[size] = cur_x;
+		out_y[size] = cur_y;
+		size++;
+		if(size == 1) {
+			box_min = box_max = Point(cur_x, cur_y);
+		}
+		else {
+			box_min.x = cur_x < box_min.x ? cur_x : box_min.x;
+			box_min.y = cur_y < box_min.y ? cur_y : box_min.y;
+			box_max.x = cur_x > box_max.x ? cur_x : box_max.x;
+			box_max.y = cur_y > box_max.y ? cur_y : box_max.y;
 		}
 	}
-	pens.push_back(PenConfig(start, pen));
+	xs.resize(size);
+	ys.resize(size);
+
+	int start = first == 0 ? 0 : first-1;
+	float start_length = first == 0 ? 0.0f : lengths.back();
+	lengths.resize(xs.size());
+	gesture_kernels::ArcLength(&xs[start], &ys[start], xs.size()-start, start_length, &lengths[start]);
 }
 
+void Gesture::View(const float *x, const float *y, const float *l, int n,
+		const Point &_anchor, const Point &_box_min, const Point &_box_max) {
+	DropDescriptor();
+	Changed();
+	xs.View(x, n);
+	ys.View(y, n);
+	anchor = _anchor;
+	box_min = _box_min;
+	box_max = _box_max;
+	if(l) {
+		lengths.View(l, n);
+	}
+	else {
+		lengths.View(0, 0);
+		lengths.resize(n);
+		if(n > 0)
+			gesture_kernels::ArcLength(&xs[0], &ys[0], n, 0.0f, &lengths[0]);
+	}
+}
 
-void Gesture::PushBack(float x, float y) {
-	points.push_back(Point(x, y));
-	need_reparam = true;
+void Gesture::Reserve(int n) {
+	xs.reserve(n);
+	ys.reserve(n);
+	lengths.reserve(n);
+}
 
-	if(points.size() == 1) {
-		anchor.x = x;
-		anchor.y = y;
+void Gesture::PopBack() {
+	DropDescriptor();
+	Changed();
+	xs.pop_back();
+	ys.pop_back();
+	lengths.pop_back();
+	cone_open = true;
+	cone_reach = 0.0f;
+
+	//Rare, just rebuild the bounding box.
+	box_min = box_max = xs.empty() ? Point() : Point(xs[0], ys[0]);
+	for(int i=1; i<xs.size(); i++) {
+		UpdateBox(xs[i], ys[i]);
 	}
+}
 
-	//Transform according to the first element.
-	points.back().x -= anchor.x;
-	points.back().y -= anchor.y;
-	if(points.size() > 1) {
-		int n = points.size();
-		if(points[n-1].x == points[n-2].x && points[n-1].y==points[n-2].y)
-			PopBack();
+void Gesture::UpdateBox(float x, float y) {
+	if(xs.size() == 1) {
+		box_min = box_max = Point(x, y);
+		return;
 	}
+	box_min.x = x < box_min.x ? x : box_min.x;
+	box_min.y = y < box_min.y ? y : box_min.y;
+	box_max.x = x > box_max.x ? x : box_max.x;
+	box_max.y = y > box_max.y ? y : box_max.y;
 }
 
-void Gesture::PopBack() {
-	points.pop_back();
-	need_reparam = true;
+Gesture::Point Gesture::Front() const {
+	return Point(xs.front(), ys.front());
 }
 
-const Gesture::Point& Gesture::Front() const {
-	return points.front();
+Gesture::Point Gesture::Back() const {
+	return Point(xs.back(), ys.back());
 }
 
-const Gesture::Point& Gesture::Back() const {
-	return points.back();
+Gesture::Point Gesture::Get(int index) const {
+	return Point(xs[index], ys[index]);
 }
 
-const Gesture::Point& Gesture::Get(int index) const {
-	return points[index];
+int Gesture::Size() const {
+	return (int)xs.size();
 }
 
-int Gesture::Size() const {
-	return (int)points.size();
+float Gesture::LengthAt(int index) const {
+	return lengths[index];
 }
 
 float Gesture::Length() const {
-	Parameterization();
-	return length;
+	return lengths.empty() ? 0.0f : lengths.back();
 }
 
  /**
-	* Simple binary search for Meta according to p. Return the index of largest element that are no greater than val.
-	* Any p out of (0.0, 1.0) will trigger assertion.
+	* Simple binary search for arc length val. Return the index of largest element that are no greater than val.
+	* Any val out of (0.0, Length()) will trigger assertion.
 	*/
-int Gesture::BinarySearch(const std::vector<Gesture::Meta> &input, const Gesture::Meta &val) {
+int Gesture::BinarySearch(const FloatArray &input, float val) {
 	int left=0, right=input.size()-1;
 
-	assert(val.p > 0.0f && val.p < 1.0f);
+	assert(val > 0.0f && val < input.back());
 
 	while(right-left > 1) {
 		int mid = (left+right)/2;
-		if(input[mid].p == val.p)
+		if(input[mid] == val)
 			return mid;
-		else if(input[mid].p <val.p) {
+		else if(input[mid] <val) {
 			left = mid;
 		}
 		else {
@@ -206,97 +484,126 @@ int Gesture::BinarySearch(const std::vector<Gesture::Meta> &input, const Gesture
 	return left;
 }
 
-namespace {
-	Gesture::Point Lerp(const Gesture::Point &lhs, const Gesture::Point &rhs, float p) {
-		Gesture::Point result;
-		result.x = lhs.x * (1-p) + rhs.x * p;
-		result.y = lhs.y * (1-p) + rhs.y * p;
-		return result;
-	}
-}
-
 Gesture::Point Gesture::Sample(float p) const {
 	assert(p>=0.0f && p <= 1.0f);
-	Parameterization();
 	if(p == 0.0f)
-		return points.front();
+		return Front();
 	if(p == 1.0f)
-		return points.back();
+		return Back();
 
-	Meta dummy;
-	dummy.p = p;
-	int left_index = BinarySearch(metas, dummy);
+	//Parameterization is normalized here on demand, lengths stay in pixels.
+	float l = p*Length();
+	if(l >= Length())
+		return Back();
+	int left_index = BinarySearch(lengths, l);
 
-	return Sample(left_index, left_index+1, p);
+	return Sample(left_index, left_index+1, l);
 }
 
-Gesture::Point Gesture::Sample(int left, int right, float p) const {
+Gesture::Point Gesture::Sample(int left, int right, float l) const {
 	assert(right > left);
-	float left_p = metas[left].p, right_p = metas[right].p;
+	float left_l = lengths[left], right_l = lengths[right];
 	
-	assert(p>=left_p && p<=right_p);
-	float new_p =  (p-left_p)/(right_p - left_p);
+	assert(l>=left_l && l<=right_l);
+	float new_p =  (l-left_l)/(right_l - left_l);
 
 	//Do linear interpolation.
-	return Lerp(points[left], points[right], new_p);
+	Point result;
+	result.x = xs[left] * (1-new_p) + xs[right] * new_p;
+	result.y = ys[left] * (1-new_p) + ys[right] * new_p;
+	return result;
 }
 
 void Gesture::UniformSample(int sample_size, std::vector<Gesture::Point> *result, float start, float end) const {
+	std::vector<float> buf(sample_size*2);
+	UniformSample(sample_size, &buf[0], &buf[sample_size], start, end);
+	result->clear();
+	for(int i=0; i<sample_size; i++) {
+		result->push_back(Point(buf[i], buf[sample_size+i]));
+	}
+	assert(result->size() == sample_size);
+}
+
+void Gesture::UniformSample(int sample_size, float *out_x, float *out_y, float start, float end) const {
 	assert(sample_size >= 2);
 	assert(end > start && start >=0.0f && end <= 1.0f);
-	assert(points.size() > 1);
-	Parameterization();
-
-	int left_index = 0, right_index = points.size()-2;
-	if(start != 0.0f) {
-		Meta dummy;
-		dummy.p = start;
-		left_index = BinarySearch(metas, dummy);
+	assert(xs.size() > 1);
+
+	float length = Length();
+	float start_l = start*length, end_l = end*length;
+	int left_index = 0, right_index = xs.size()-2;
+	if(start != 0.0f && start_l < length) {
+		left_index = BinarySearch(lengths, start_l);
 	}
-	if(end != 1.0f) {
-		Meta dummy;
-		dummy.p = end;
-		right_index = BinarySearch(metas, dummy);
+	if(end != 1.0f && end_l < length) {
+		right_index = BinarySearch(lengths, end_l);
 	}
 
+	//Walk the segments once to find where each sample lands, then interpolate a chunk at a time. Chunks keep the
+	//indices and weights on the stack.
+	const int kChunk = 64;
+	int indices[kChunk];
+	float weights[kChunk];
 	float interval = (end - start)/(float)sample_size;
-	result->clear();
-	result->push_back(Sample(left_index, left_index+1, start));
 	int cur = left_index;
-	for(int i=1; i<sample_size-1; i++) {
-		float p = start + interval*i;
-		while(metas[cur+1].p < p ) {
-			cur++;
-			assert(cur <= right_index);
+	for(int base=0; base<sample_size; base+=kChunk) {
+		int size = sample_size-base < kChunk ? sample_size-base : kChunk;
+		for(int k=0; k<size; k++) {
+			int i = base+k;
+			float l = (start + interval*i)*length;
+			if(i == 0) {
+				l = start_l;
+			}
+			else if(i == sample_size-1) {
+				l = end_l;
+				cur = right_index;
+			}
+			else {
+				while(lengths[cur+1] < l ) {
+					cur++;
+					assert(cur <= right_index);
+				}
+			}
+			float left_l = lengths[cur], right_l = lengths[cur+1];
+			assert(l>=left_l && l<=right_l);
+			indices[k] = cur;
+			weights[k] = (l-left_l)/(right_l - left_l);
 		}
-		result->push_back(Sample(cur, cur+1, p));
+		gesture_kernels::Lerp(&xs[0], &ys[0], indices, weights, size, out_x+base, out_y+base);
 	}
-	result->push_back(Sample(right_index, right_index+1, end));
-	assert(result->size() == sample_size);
 }
 
-void Gesture::Parameterization() const {
-	if(!need_reparam)
-		return;
-	if(points.empty()) {
-		length = 0.0f;
-		metas.clear();
-		need_reparam = false;
-		return;
-	}
+void Gesture::SampleLengths(const float *l, int n, float *out_x, float *out_y) const {
+	int cursor = 0;
+	SampleLengths(l, n, out_x, out_y, &cursor);
+}
 
-	metas.resize(points.size());
-	length = 0.0f;
-	metas[0].p = length;
-	for(int i=1; i<points.size(); i++) {
-		length += Point::Distance(points[i-1], points[i]);
-		metas[i].p = length;
-	}
-	//normalize 
-	if(length != 0.0f) {
-		for(int i=0; i<points.size(); i++) {
-			metas[i].p /= length;
+void Gesture::SampleLengths(const float *l, int n, float *out_x, float *out_y, int *cursor) const {
+	assert(xs.size() > 1);
+	float length = Length();
+	int last = xs.size()-2;
+
+	//Work in chunks so the segment indices and weights can live on the stack.
+	const int kChunk = 64;
+	int indices[kChunk];
+	float weights[kChunk];
+	int cur = *cursor;
+	for(int base=0; base<n; base+=kChunk) {
+		int size = n-base < kChunk ? n-base : kChunk;
+		for(int i=0; i<size; i++) {
+			float target = l[base+i];
+			if(target >= length) {
+				indices[i] = last;
+				weights[i] = 1.0f;
+				continue;
+			}
+			while(lengths[cur+1] < target) {
+				cur++;
+			}
+			indices[i] = cur;
+			weights[i] = (target-lengths[cur])/(lengths[cur+1]-lengths[cur]);
 		}
+		gesture_kernels::Lerp(&xs[0], &ys[0], indices, weights, size, out_x+base, out_y+base);
 	}
-	need_reparam = false;
+	*cursor = cur;
 }
\ No newline at end of file
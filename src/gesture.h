@@ -1,10 +1,8 @@
 #ifndef GESTURE_H_
 #define GESTURE_H_
 
+#include <math.h>
 #include <vector>
-#include <wx/pen.h>
-
-class wxMemoryDC;
 
 /**
  * It is better to abstract the Gesture to some extent.
@@ -17,10 +15,17 @@ class wxMemoryDC;
  * For simplicity here, I am using a pixel vector to represent Gestures.
  * A Gesture is composed of a piecewise linear function and the compare function is measured by 
  * euclidean distance between two functions.
+ *
+ * Gesture is geometry only and does not depend on wxWidgets, so the recognition code builds without it, e.g. on a
+ * headless server. How a gesture looks on screen, its pens and placement, is kept by a GestureRenderer instead.
  */
 
 class Gesture {
 public:
+	enum {kMaxSampleSize = 100};		//Max number of samples taken by Compare.
+	enum {kStrokeReserve = 4096};		//Points reserved for a stroke being drawn, @see Reserve().
+	static const float kErrorClamp;		//Squared distance no greater than this is ignored by Compare.
+
 	struct Point {
 		float x, y;
 
@@ -36,22 +41,98 @@ public:
 		}
 	};
 
-private:
-	struct Meta {
-		float p;
+	/**
+	 * Fixed resolution resample of a whole gesture, used by templates whose geometry never changes after loading.
+	 * Sample i sits at arc length lengths[i] = i*length/(kSize-1), so a prefix of the template is just the first
+	 * few samples and Compare only needs to resample the other side.
+	 * A coarse level keeps every kCoarseStep-th sample, together with the bounding box of each coarse prefix,
+	 * so that hopeless candidates can be rejected before the full resolution compare. @See BoxBound(), CoarseBound()
+	 */
+	struct Descriptor {
+		enum {kSize = kMaxSampleSize+1};		//kMaxSampleSize intervals.
+		enum {kCoarseStep = 4, kCoarseSize = kMaxSampleSize/kCoarseStep+1};
+
+		float length;
+		float xs[kSize];
+		float ys[kSize];
+		float lengths[kSize];
+
+		//Coarse sample i is sample i*kCoarseStep.
+		float coarse_xs[kCoarseSize];
+		float coarse_ys[kCoarseSize];
+		float coarse_lengths[kCoarseSize];
+		//Bounding box of samples [0, i*kCoarseStep].
+		Point box_min[kCoarseSize];
+		Point box_max[kCoarseSize];
 	};
 
-	struct PenConfig {
-		float p;
-		wxPen pen;
+	/**
+	 * Online simplification of PushBack, for strokes drawn with far more points than their shape needs, e.g. with a
+	 * high polling rate mouse. The last point always is the latest one pushed, the one before it is dropped when the
+	 * new segment stays within distance of every point dropped since the last one kept, turning by no more than angle.
+	 * Same tolerance as simplify::Rdp, which does the same for templates.
+	 */
+	struct Simplify {
+		float distance;			//Pixels, 0 to keep every point.
+		float angle;			//Radians.
 
-		PenConfig() {}
-		PenConfig(float _p, const wxPen &_pen) : p(_p), pen(_pen) {}
+		Simplify(float _distance = 0.0f, float _angle = 0.0f) : distance(_distance), angle(_angle) {}
 	};
+	static const Simplify kStrokeSimplify;		//For strokes being drawn.
 
 private:
-	typedef std::vector<Point> PointVector;		//Pixel is cheap to copy, no need to use pointer.
-	typedef std::vector<Meta> MetaVector;		//Store some metadata for Point, for example parameterization of each point. 
+	/**
+	 * Points are stored as structure of arrays, x and y in separate arrays, so that the kernels can vectorize.
+	 * An array either owns its floats or views floats stored elsewhere, @see View(). Reading goes through the same
+	 * pointer either way. Anything that modifies a view copies the floats first, and copying an array always owns.
+	 */
+	class FloatArray {
+	public:
+		FloatArray() : ptr(0), count(0) {}
+		FloatArray(const FloatArray &rhs) : owned(rhs.ptr, rhs.ptr+rhs.count) { Sync(); }
+		FloatArray &operator=(const FloatArray &rhs) {
+			if(this != &rhs) {
+				owned.assign(rhs.ptr, rhs.ptr+rhs.count);
+				Sync();
+			}
+			return *this;
+		}
+
+		void View(const float *p, int n) {
+			owned.clear();
+			ptr = p;
+			count = n;
+		}
+
+		int size() const { return count; }
+		bool empty() const { return count == 0; }
+		const float &operator[](int i) const { return ptr[i]; }
+		float &operator[](int i) { Detach(); return owned[i]; }
+		float front() const { return ptr[0]; }
+		float back() const { return ptr[count-1]; }
+
+		void push_back(float v) { Detach(); owned.push_back(v); Sync(); }
+		void pop_back() { Detach(); owned.pop_back(); Sync(); }
+		void reserve(int n) { Detach(); owned.reserve(n); Sync(); }
+		void resize(int n) { Detach(); owned.resize(n); Sync(); }
+
+	private:
+		void Detach() {
+			if(count != 0 && ptr != (owned.empty() ? 0 : &owned[0])) {
+				owned.assign(ptr, ptr+count);
+				Sync();
+			}
+		}
+		void Sync() {
+			ptr = owned.empty() ? 0 : &owned[0];
+			count = (int)owned.size();
+		}
+
+	private:
+		std::vector<float> owned;
+		const float *ptr;
+		int count;
+	};
 
 public:
 	Gesture();
@@ -59,24 +140,60 @@ public:
 
 	Gesture(const Gesture &rhs);
 	void operator=(const Gesture &rhs);
-	
-	void Render(wxMemoryDC &dc) const;
-	void ClearPens();
-	void SetPen( float start, const wxPen& pen);
-	
 
 	/****************Accessors and Mutators.****************/
 	void PushBack(float x, float y);
+	//Batch version of PushBack, without simplification.
+	void Append(const float *x, const float *y, int n);
 	void PopBack();
-	const Point& Front() const;
-	const Point& Back() const;
-	const Point& Get(int index) const;
+	//Simplify points pushed from now on, points already there are kept.
+	void SetSimplify(const Simplify &s) { simplify = s; }
+	//Points PushBack has dropped so far.
+	int Simplified() const { return simplified; }
+	/**
+	 * Make room for n points, so that growing up to that does not allocate. Strokes being drawn and the copies made of
+	 * them reserve kStrokeReserve, which keeps updates off the heap.
+	 */
+	void Reserve(int n);
+	Point Front() const;
+	Point Back() const;
+	Point Get(int index) const;
 	int Size() const;
+	//Arc length from the first point to point index.
+	float LengthAt(int index) const;
 
 	Point GetAnchor() const  { return anchor; }
+	/**
+	 * Changes whenever the points do and is never shared by two gestures, so that what is derived from the points and
+	 * kept elsewhere, e.g. the paths of a GestureRenderer, can tell whether it is still up to date.
+	 */
+	long Revision() const { return revision; }
+	//Bounding box of the points, relative to anchor.
+	Point GetBoxMin() const { return box_min; }
+	Point GetBoxMax() const { return box_max; }
+
+	/**
+	 * Make the gesture a read only view of points stored elsewhere, e.g. a mapped GestureLibrary, without copying.
+	 * Points are relative to anchor, the way PushBack stores them, and box bounds them. lengths is the arc length at
+	 * each point, pass 0 to have it computed here. The storage must outlive the gesture, modifying the gesture
+	 * copies the points first.
+	 */
+	void View(const float *xs, const float *ys, const float *lengths, int n,
+		const Point &anchor, const Point &box_min, const Point &box_max);
 
-	Gesture& SetTransform(float x, float y) { transform.x = x; transform.y = y; return *this;}
-	Point GetTransform() { return transform; }
+	/**
+	 * Build the Descriptor of current points. Call it once the gesture is complete, any later change to the points
+	 * drops the descriptor. Compare will use it automatically.
+	 */
+	void BuildDescriptor();
+	//Same, but build into storage kept by the caller, e.g. in an arena, which must outlive the gesture.
+	void BuildDescriptor(Descriptor *storage);
+	/**
+	 * Use storage kept by the caller as the Descriptor without building it, storage must hold the Descriptor of the
+	 * very same points, e.g. copied from another gesture. It must outlive the gesture.
+	 */
+	void SetDescriptor(Descriptor *storage) { DropDescriptor(); descriptor = storage; }
+	const Descriptor *GetDescriptor() const { return descriptor; }
 
 	/****************Compare related.****************/
 	/**
@@ -84,9 +201,28 @@ public:
 	 * It measures average euclidean distance.
 	 * Any of the gesture could be incomplete. The function will take the min length and truncate the other gesture
 	 * with that length. Then make comparison.
+	 * If either gesture has a Descriptor, the descriptor is sliced instead of resampled and the other gesture is
+	 * sampled at the very same arc lengths. Samples may land up to one interval away from where resampling both
+	 * sides puts them, so the two paths differ slightly.
 	 */
 	float Compare(const Gesture& rhs) const;
 
+	/**
+	 * Bounded version of Compare. It stops as soon as the accumulated error proves the result is greater than bound
+	 * and returns some value greater than bound. Otherwise it returns the same as Compare.
+	 * Early abandon needs a Descriptor on either side, without one this is just Compare.
+	 */
+	float Compare(const Gesture& rhs, float bound) const;
+
+	/**
+	 * Cheap lower bounds of Compare(rhs), rhs being a template with a Descriptor. They return 0.0f when no bound
+	 * can be derived, e.g. rhs has no Descriptor.
+	 * BoxBound uses the distance between bounding boxes, every sample pair is at least that far apart.
+	 * CoarseBound only sums the coarse level of the Descriptor, which is part of the full sum.
+	 */
+	float BoxBound(const Gesture& rhs) const;
+	float CoarseBound(const Gesture& rhs) const;
+
 	float Length() const;
 
 	/**
@@ -105,24 +241,52 @@ public:
 	 */
 	void UniformSample(int sample_size, std::vector<Gesture::Point> *result, float start = 0.0f, float end = 1.0f) const;
 
+	//Structure of arrays version of UniformSample, xs and ys must have room for sample_size elements.
+	void UniformSample(int sample_size, float *xs, float *ys, float start = 0.0f, float end = 1.0f) const;
+
+	//Sample at ascending arc lengths in pixels, anything beyond Length() is clamped to the last point.
+	void SampleLengths(const float *l, int n, float *out_x, float *out_y) const;
+
 private:
-	//Parameterization according to arc length. 
-	void Parameterization() const;
-	static int BinarySearch(const std::vector<Gesture::Meta> &input, const Gesture::Meta &val);
-	Point Sample(int left, int right, float p) const;
+	static int BinarySearch(const FloatArray &input, float val);
+	//l is arc length in pixels.
+	Point Sample(int left, int right, float l) const;
+	/**
+	 * Sample at ascending arc lengths, anything beyond Length() is clamped to the last point.
+	 * cursor is the segment to start searching from, it is updated so that the next batch can carry on from there.
+	 */
+	void SampleLengths(const float *l, int n, float *out_x, float *out_y, int *cursor) const;
+	float Compare(const Descriptor &rhs, float bound) const;
+	//Number of template samples Compare takes against rhs, minus one.
+	int PrefixSize(const Descriptor &rhs) const;
+	void UpdateBox(float x, float y);
+	//Whether the last point can make way for x, y within Simplify, narrowing the cone if so.
+	bool Supersede(float x, float y);
+	void DropDescriptor();
+	//Points changed, take a new revision.
+	void Changed();
 
 private:
-	PointVector points;
+	FloatArray xs, ys;
 	Point anchor;
-	Point transform;
+	Point box_min, box_max;		//Bounding box of points, relative to anchor.
+	long revision;
+
+	//Unnormalized arc length at each point, parallel to xs and ys. Maintained on every append.
+	//Parameterization p of a point is lengths[i]/Length(), computed only when sampling.
+	FloatArray lengths;
 
-	//Render related.
-	std::vector<PenConfig> pens;
+	Descriptor *descriptor;		//Only templates have one.
+	bool own_descriptor;		//False if the storage is kept by someone else.
 
-	 //Do lazy evaluation.
-	mutable bool need_reparam;
-	mutable float length;
-	mutable MetaVector metas;
+	Simplify simplify;
+	/**
+	 * Points dropped since the last one kept, and the last point, lie within cone_reach of the one before the last
+	 * point, in directions that differ from cone_base by [cone_low, cone_high]. An open cone has no bound yet.
+	 */
+	bool cone_open;
+	float cone_base, cone_low, cone_high, cone_reach;
+	int simplified;
 };
 
 #endif			//GESTURE_H_
\ No newline at end of file
@@ -0,0 +1,435 @@
+#include "gesture_index.h"
+#include "gesture.h"
+#include "gesture_kernels.h"
+#include "worker_pool.h"
+
+#include <math.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <limits>
+
+//Things that are configurable.
+const float GestureIndex::kMinLengthRatio = 0.9f;
+static const float kBucketRatio = 1.02f;		//Length range of a bucket, as a ratio.
+
+namespace {
+	//Smaller error first, ties by id, so the first inserted wins the same as in a linear scan.
+	struct MatchLess {
+		bool operator()(const GestureIndex::Match &lhs, const GestureIndex::Match &rhs) const {
+			if(lhs.error != rhs.error)
+				return lhs.error < rhs.error;
+			return lhs.id < rhs.id;
+		}
+	};
+}
+
+struct GestureIndex::Query {
+	const Gesture *gesture;
+	float length;
+	int k;			//0 for no limit.
+	float bound;	//Anything with a larger error can't make it into result.
+	float min_ratio, max_ratio;
+	std::vector<Match> *result;		//Max heap by MatchLess while searching, so the worst match is on top.
+	Stats stats;
+
+	//The query sampled at the reference length of the current bucket, and how far that may be off.
+	float xs[kPrefixSize], ys[kPrefixSize];
+	float slack;
+
+	/**
+	 * Any template with an error no greater than bound lies within this distance of the query samples.
+	 *
+	 * Let d be the distances between the samples Compare takes and the template samples. Compare takes at least
+	 * kPrefixSize and at most Descriptor::kSize samples, and only ignores squared distances up to kErrorClamp, so
+	 *		error <= bound  =>  |d|^2 <= bound^2*kSize + kPrefixSize*kErrorClamp over the first kPrefixSize samples.
+	 * Compare samples the query at i*length/kMaxSampleSize of the template, the query samples here are taken at the
+	 * reference length instead. The gesture can't move faster than its arc length, so sample i is off by at most
+	 * i*|length-reference|/kMaxSampleSize, which sums up to slack.
+	 * The last factor and term cover float rounding.
+	 */
+	float Radius() const {
+		float r = sqrt(bound*bound*Gesture::Descriptor::kSize + kPrefixSize*Gesture::kErrorClamp) + slack;
+		return r*1.001f + 0.01f;
+	}
+};
+
+GestureIndex::GestureIndex() {
+
+}
+
+void GestureIndex::Clear() {
+	entries.clear();
+	ids.clear();
+	buckets.clear();
+	loose.clear();
+}
+
+void GestureIndex::Build(const std::vector<std::pair<std::string, const Gesture *> > &templates) {
+	Clear();
+	for(int i=0; i<templates.size(); i++) {
+		Insert(templates[i].first, templates[i].second);
+	}
+	Rebuild();
+}
+
+int GestureIndex::Insert(const std::string &name, const Gesture *g) {
+	Entry entry;
+	entry.name = name;
+	entry.gesture = g;
+	entry.length = g->Length();
+	entry.removed = false;
+	int id = entries.size();
+	entries.push_back(entry);
+	//g inserted again replaces its entry, so that Remove leaves nothing of it behind.
+	IdMap::iterator previous = ids.find(g);
+	if(previous != ids.end()) {
+		entries[previous->second].removed = true;
+		previous->second = id;
+	}
+	else {
+		ids[g] = id;
+	}
+
+	if(!g->GetDescriptor() || entry.length <= 0.0f) {
+		loose.push_back(id);
+		return id;
+	}
+
+	int key = BucketKey(entry.length);
+	BucketMap::iterator it = buckets.find(key);
+	if(it == buckets.end()) {
+		Bucket &bucket = buckets[key];
+		bucket.reference = (float)pow(kBucketRatio, key+0.5f);
+		bucket.min_length = bucket.max_length = entry.length;
+		bucket.nodes.push_back(Node());
+		it = buckets.find(key);
+	}
+	Bucket &bucket = it->second;
+	bucket.min_length = entry.length < bucket.min_length ? entry.length : bucket.min_length;
+	bucket.max_length = entry.length > bucket.max_length ? entry.length : bucket.max_length;
+	InsertToBucket(bucket, id);
+	return id;
+}
+
+void GestureIndex::Remove(const Gesture *g) {
+	IdMap::iterator it = ids.find(g);
+	if(it == ids.end())
+		return;
+	entries[it->second].removed = true;
+	ids.erase(it);
+}
+
+void GestureIndex::Rebuild() {
+	for(BucketMap::iterator it=buckets.begin(); it!=buckets.end(); it++) {
+		Bucket &bucket = it->second;
+		std::vector<int> ids;
+		for(int i=0; i<bucket.nodes.size(); i++) {
+			const Node &node = bucket.nodes[i];
+			if(node.vantage >= 0 && !entries[node.vantage].removed)
+				ids.push_back(node.vantage);
+			for(int j=0; j<node.entries.size(); j++) {
+				if(!entries[node.entries[j]].removed)
+					ids.push_back(node.entries[j]);
+			}
+		}
+		//Keep the order of insertion so that the result does not depend on the history.
+		std::sort(ids.begin(), ids.end());
+		bucket.nodes.clear();
+		bucket.nodes.push_back(Node());
+		BuildNode(bucket, 0, ids);
+	}
+}
+
+void GestureIndex::Nearest(const Gesture *query, int k, float max_error, float min_ratio, float max_ratio,
+							std::vector<Match> *result, Stats *stats, WorkerPool *pool) const {
+	assert(k > 0);
+	Query q;
+	q.gesture = query;
+	q.length = query->Length();
+	q.k = k;
+	q.bound = max_error;
+	q.min_ratio = min_ratio;
+	q.max_ratio = max_ratio;
+	q.result = result;
+	Search(q, pool);
+	if(stats) {
+		stats->distances += q.stats.distances;
+		stats->compares += q.stats.compares;
+	}
+}
+
+void GestureIndex::Within(const Gesture *query, float max_error, float min_ratio, float max_ratio,
+							std::vector<Match> *result, Stats *stats, WorkerPool *pool) const {
+	Query q;
+	q.gesture = query;
+	q.length = query->Length();
+	q.k = 0;
+	q.bound = max_error;
+	q.min_ratio = min_ratio;
+	q.max_ratio = max_ratio;
+	q.result = result;
+	Search(q, pool);
+	if(stats) {
+		stats->distances += q.stats.distances;
+		stats->compares += q.stats.compares;
+	}
+}
+
+int GestureIndex::BucketKey(float length) {
+	assert(length > 0.0f);
+	return (int)floor(log(length)/log(kBucketRatio));
+}
+
+//Searches a chunk of buckets, each with a query of its own.
+class GestureIndex::SearchTask : public WorkerPool::Task {
+public:
+	SearchTask(const GestureIndex *_index, const std::vector<const Bucket *> &_order, std::vector<Query> &_queries, bool _use_trees)
+		: index(_index), order(_order), queries(_queries), use_trees(_use_trees) {}
+
+	virtual void Run(int chunk, int begin, int end) {
+		for(int i=begin; i<end; i++) {
+			index->SearchBucket(queries[i], *order[i], use_trees);
+		}
+	}
+
+private:
+	const GestureIndex *index;
+	const std::vector<const Bucket *> &order;
+	std::vector<Query> &queries;
+	bool use_trees;
+};
+
+void GestureIndex::Search(Query &q, WorkerPool *pool) const {
+	q.result->clear();
+	for(int i=0; i<loose.size(); i++) {
+		Refine(q, loose[i]);
+	}
+
+	//The bound only holds if Compare takes at least kPrefixSize samples.
+	bool use_trees = q.min_ratio >= kMinLengthRatio && q.gesture->Size() > 1;
+
+	//Buckets which may hold templates of an admissible length, one more on each side against rounding.
+	//Closer lengths usually match better, so they go first and tighten the bound for the rest.
+	BucketMap::const_iterator first = buckets.begin(), last = buckets.end();
+	int center = 0;
+	if(q.length > 0.0f) {
+		center = BucketKey(q.length);
+		if(q.max_ratio > 0.0f)
+			first = buckets.lower_bound(BucketKey(q.length/q.max_ratio)-1);
+		if(q.min_ratio > 0.0f)
+			last = buckets.upper_bound(BucketKey(q.length/q.min_ratio)+1);
+	}
+	std::vector<std::pair<int, int> > keys;
+	for(BucketMap::const_iterator it=first; it!=last; it++) {
+		keys.push_back(std::make_pair(abs(it->first-center), it->first));
+	}
+	std::sort(keys.begin(), keys.end());
+	std::vector<const Bucket *> order;
+	for(int i=0; i<keys.size(); i++) {
+		order.push_back(&buckets.find(keys[i].second)->second);
+	}
+
+	MatchLess less;
+	if(!pool || pool->GetThreadCount() == 1 || order.size() <= 1) {
+		for(int i=0; i<order.size(); i++) {
+			SearchBucket(q, *order[i], use_trees);
+		}
+		std::sort_heap(q.result->begin(), q.result->end(), less);
+		return;
+	}
+
+	//Every bucket collects its own best k, the best k overall are among them. Only the bound found so far is shared.
+	std::vector<Query> queries(order.size(), q);
+	std::vector<std::vector<Match> > results(order.size());
+	for(int i=0; i<order.size(); i++) {
+		queries[i].result = &results[i];
+		queries[i].result->clear();
+		queries[i].stats = Stats();
+	}
+	SearchTask task(this, order, queries, use_trees);
+	pool->Run(&task, order.size(), 1);
+
+	std::vector<Match> &all = *q.result;
+	for(int i=0; i<order.size(); i++) {
+		all.insert(all.end(), results[i].begin(), results[i].end());
+		q.stats.distances += queries[i].stats.distances;
+		q.stats.compares += queries[i].stats.compares;
+	}
+	std::sort(all.begin(), all.end(), less);
+	if(q.k > 0 && all.size() > q.k)
+		all.erase(all.begin()+q.k, all.end());
+}
+
+void GestureIndex::SearchBucket(Query &q, const Bucket &bucket, bool use_trees) const {
+	if(!use_trees) {
+		for(int i=0; i<bucket.nodes.size(); i++) {
+			const Node &node = bucket.nodes[i];
+			if(node.vantage >= 0)
+				Refine(q, node.vantage);
+			for(int j=0; j<node.entries.size(); j++) {
+				Refine(q, node.entries[j]);
+			}
+		}
+		return;
+	}
+
+	float lengths[kPrefixSize];
+	float slack = 0.0f;
+	for(int i=0; i<kPrefixSize; i++) {
+		lengths[i] = bucket.reference*i/Gesture::kMaxSampleSize;
+		slack += (float)i*i;
+	}
+	q.gesture->SampleLengths(lengths, kPrefixSize, q.xs, q.ys);
+	float off = std::max(bucket.max_length-bucket.reference, bucket.reference-bucket.min_length);
+	q.slack = sqrt(slack)/Gesture::kMaxSampleSize*off;
+	SearchNode(q, bucket, 0);
+}
+
+void GestureIndex::SearchNode(Query &q, const Bucket &bucket, int n) const {
+	const Node &node = bucket.nodes[n];
+	if(node.vantage < 0) {
+		for(int i=0; i<node.entries.size(); i++) {
+			Refine(q, node.entries[i]);
+		}
+		return;
+	}
+
+	const Gesture::Descriptor *d = entries[node.vantage].gesture->GetDescriptor();
+	float distance = Distance(q.xs, q.ys, d->xs, d->ys);
+	q.stats.distances++;
+	Refine(q, node.vantage);
+
+	//Nearer side first. The radius is taken again for the second, as the bound may have shrunk.
+	int c = distance < node.radius ? 0 : 1;
+	for(int i=0; i<2; i++, c=1-c) {
+		float radius = q.Radius();
+		if(distance - radius > node.high[c] || distance + radius < node.low[c])
+			continue;
+		SearchNode(q, bucket, node.children[c]);
+	}
+}
+
+void GestureIndex::Refine(Query &q, int id) const {
+	const Entry &entry = entries[id];
+	if(entry.removed)
+		return;
+
+	//Same length test as the recognizer.
+	const Gesture *target = entry.gesture;
+	if(q.length / target->Length() < q.min_ratio)
+		return;
+	if(q.length > target->Length()*q.max_ratio)
+		return;
+	if(q.gesture->BoxBound(*target) > q.bound || q.gesture->CoarseBound(*target) > q.bound)
+		return;
+
+	q.stats.compares++;
+	float error = q.gesture->Compare(*target, q.bound);
+	if(error > q.bound)
+		return;
+
+	Match match(id, error);
+	MatchLess less;
+	std::vector<Match> &heap = *q.result;
+	if(q.k > 0 && heap.size() == q.k) {
+		if(!less(match, heap.front()))
+			return;
+		std::pop_heap(heap.begin(), heap.end(), less);
+		heap.back() = match;
+	}
+	else {
+		heap.push_back(match);
+	}
+	std::push_heap(heap.begin(), heap.end(), less);
+
+	if(q.k > 0 && heap.size() == q.k)
+		q.bound = heap.front().error;
+}
+
+void GestureIndex::BuildNode(Bucket &bucket, int n, std::vector<int> &ids) {
+	if(ids.size() <= kLeafSize) {
+		bucket.nodes[n].vantage = -1;
+		bucket.nodes[n].entries.swap(ids);
+		return;
+	}
+
+	//The entry farthest from an arbitrary one lies near the rim, which splits better than one in the middle.
+	int farthest = 0;
+	float max_distance = -1.0f;
+	for(int i=1; i<ids.size(); i++) {
+		float d = Distance(ids[0], ids[i]);
+		if(d > max_distance) {
+			max_distance = d;
+			farthest = i;
+		}
+	}
+	std::swap(ids[farthest], ids.back());
+	int vantage = ids.back();
+	ids.pop_back();
+
+	//Split at the median distance.
+	std::vector<std::pair<float, int> > distances(ids.size());
+	for(int i=0; i<ids.size(); i++) {
+		distances[i] = std::make_pair(Distance(vantage, ids[i]), ids[i]);
+	}
+	int half = distances.size()/2;
+	std::nth_element(distances.begin(), distances.begin()+half, distances.end());
+
+	std::vector<int> children[2];
+	float low[2], high[2];
+	for(int c=0; c<2; c++) {
+		low[c] = std::numeric_limits<float>::infinity();
+		high[c] = -std::numeric_limits<float>::infinity();
+	}
+	for(int i=0; i<distances.size(); i++) {
+		int c = i < half ? 0 : 1;
+		float d = distances[i].first;
+		children[c].push_back(distances[i].second);
+		low[c] = d < low[c] ? d : low[c];
+		high[c] = d > high[c] ? d : high[c];
+	}
+
+	int child = bucket.nodes.size();
+	bucket.nodes.resize(child+2);
+	Node &node = bucket.nodes[n];
+	node.vantage = vantage;
+	node.radius = distances[half].first;
+	node.entries.clear();
+	for(int c=0; c<2; c++) {
+		node.children[c] = child+c;
+		node.low[c] = low[c];
+		node.high[c] = high[c];
+	}
+	BuildNode(bucket, child, children[0]);
+	BuildNode(bucket, child+1, children[1]);
+}
+
+void GestureIndex::InsertToBucket(Bucket &bucket, int id) {
+	int n = 0;
+	while(bucket.nodes[n].vantage >= 0) {
+		Node &node = bucket.nodes[n];
+		float d = Distance(id, node.vantage);
+		int c = d < node.radius ? 0 : 1;
+		node.low[c] = d < node.low[c] ? d : node.low[c];
+		node.high[c] = d > node.high[c] ? d : node.high[c];
+		n = node.children[c];
+	}
+
+	bucket.nodes[n].entries.push_back(id);
+	if(bucket.nodes[n].entries.size() > 2*kLeafSize) {
+		std::vector<int> ids;
+		ids.swap(bucket.nodes[n].entries);
+		BuildNode(bucket, n, ids);
+	}
+}
+
+float GestureIndex::Distance(int lhs, int rhs) const {
+	const Gesture::Descriptor *l = entries[lhs].gesture->GetDescriptor(), *r = entries[rhs].gesture->GetDescriptor();
+	return Distance(l->xs, l->ys, r->xs, r->ys);
+}
+
+float GestureIndex::Distance(const float *lhs_x, const float *lhs_y, const float *rhs_x, const float *rhs_y) {
+	//A negative clamp keeps every term.
+	return sqrt(gesture_kernels::ClampedSquareError(lhs_x, lhs_y, rhs_x, rhs_y, kPrefixSize, -1.0f, 0.0f));
+}
@@ -0,0 +1,139 @@
+#ifndef GESTURE_INDEX_H_
+#define GESTURE_INDEX_H_
+
+#include <map>
+#include <string>
+#include <vector>
+#include <utility>
+
+class Gesture;
+class WorkerPool;
+
+/**
+ * Search structure over template gestures, answering exact nearest and within-threshold queries by Gesture::Compare
+ * without comparing against every template.
+ *
+ * Compare is not a metric by itself (the clamp, and the prefix depending on the length ratio), so the index works as
+ * filter and refine:
+ *		Every template is represented by the first kPrefixSize samples of its Descriptor and organized in vantage point
+ *		trees under the plain euclidean distance between those vectors, which is a metric.
+ *		The query is sampled at the same arc lengths. From the distance between the two vectors a lower bound of Compare
+ *		follows, so whole subtrees are skipped by the triangle inequality and only the survivors are refined by Compare.
+ * The answer is identical to comparing against every template.
+ *
+ * The query has to be sampled at the arc lengths of each template, which depend on the template length. Templates are
+ * therefore grouped in buckets of similar length, each with its own tree. The query is sampled once per bucket at a
+ * reference length, and the distance to the real sample positions is bounded as the gesture is 1-Lipschitz in arc length.
+ *
+ * Templates must not change after they are inserted, as their Descriptor is used in place.
+ */
+class GestureIndex {
+public:
+	/**
+	 * Smallest min_ratio the trees can serve. Compare of such a query takes at least kPrefixSize samples of every
+	 * admissible template, which the lower bound relies on.
+	 */
+	static const float kMinLengthRatio;
+
+	struct Match {
+		int id;
+		float error;
+
+		Match(int _id, float _error) : id(_id), error(_error) {}
+	};
+
+	//How much work a query took. Mainly for tuning.
+	struct Stats {
+		int distances;		//Distances between sample vectors, each much cheaper than a Compare.
+		int compares;		//Templates refined by Compare.
+
+		Stats() : distances(0), compares(0) {}
+	};
+
+private:
+	enum {kPrefixSize = 90};		//Samples every admissible Compare covers, @see kMinLengthRatio.
+	enum {kLeafSize = 8};
+
+	struct Entry {
+		std::string name;
+		const Gesture *gesture;
+		float length;
+		bool removed;
+	};
+
+	struct Node {
+		int vantage;			//Entry id, -1 for a leaf.
+		float radius;			//Entries closer to the vantage point than radius go to children[0].
+		int children[2];
+		float low[2], high[2];	//Range of distances between the vantage point and the entries under each child.
+		std::vector<int> entries;		//Leaf only.
+
+		Node() : vantage(-1), radius(0.0f) {}
+	};
+
+	//Templates with a length within [kBucketRatio^key, kBucketRatio^(key+1)).
+	struct Bucket {
+		float reference;		//Length the query is sampled at.
+		float min_length, max_length;
+		std::vector<Node> nodes;		//nodes[0] is the root.
+	};
+
+	typedef std::map<int, Bucket> BucketMap;
+	typedef std::map<const Gesture *, int> IdMap;
+	struct Query;
+	class SearchTask;
+
+public:
+	GestureIndex();
+
+	void Clear();
+	//Replace the content with templates, id of each is its position in templates.
+	void Build(const std::vector<std::pair<std::string, const Gesture *> > &templates);
+	//Return the id of g, which must have a Descriptor to be searched efficiently. An entry of g before is removed.
+	int Insert(const std::string &name, const Gesture *g);
+	//g won't show up in any later result. The id is not reused, and g must live until the next Build or Clear.
+	void Remove(const Gesture *g);
+	//Rebalance the trees after lots of Insert.
+	void Rebuild();
+
+	const std::string &GetName(int id) const { return entries[id].name; }
+	const Gesture *Get(int id) const { return entries[id].gesture; }
+	bool IsRemoved(int id) const { return entries[id].removed; }
+	//Including removed templates.
+	int Size() const { return entries.size(); }
+	int LiveSize() const { return ids.size(); }
+
+	/**
+	 * The k templates with the smallest Compare error against query, no greater than max_error, sorted by error.
+	 * Ties are broken by id, as BestMatch over the templates in order of insertion does.
+	 * Only templates that pass the same length test as the recognizer are considered:
+	 *		query length / template length >= min_ratio and query length <= template length * max_ratio.
+	 * min_ratio below kMinLengthRatio is allowed, but templates are then compared one by one.
+	 * With a pool, buckets are searched in parallel and merged afterwards, the result stays the same.
+	 */
+	void Nearest(const Gesture *query, int k, float max_error, float min_ratio, float max_ratio,
+					std::vector<Match> *result, Stats *stats = 0, WorkerPool *pool = 0) const;
+	//Every template within max_error, sorted by error.
+	void Within(const Gesture *query, float max_error, float min_ratio, float max_ratio,
+					std::vector<Match> *result, Stats *stats = 0, WorkerPool *pool = 0) const;
+
+private:
+	static int BucketKey(float length);
+	void Search(Query &q, WorkerPool *pool) const;
+	void SearchBucket(Query &q, const Bucket &bucket, bool use_trees) const;
+	void SearchNode(Query &q, const Bucket &bucket, int node) const;
+	void Refine(Query &q, int id) const;
+	void BuildNode(Bucket &bucket, int node, std::vector<int> &ids);
+	void InsertToBucket(Bucket &bucket, int id);
+	//Distance between the prefix sample vectors of two entries.
+	float Distance(int lhs, int rhs) const;
+	static float Distance(const float *lhs_x, const float *lhs_y, const float *rhs_x, const float *rhs_y);
+
+private:
+	std::vector<Entry> entries;
+	IdMap ids;					//Of the entries not removed.
+	BucketMap buckets;
+	std::vector<int> loose;		//Templates without a Descriptor, always compared one by one.
+};
+
+#endif			//GESTURE_INDEX_H_
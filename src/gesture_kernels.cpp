@@ -0,0 +1,272 @@
+#include "gesture_kernels.h"
+
+#include <math.h>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+	#define GESTURE_KERNELS_X86 1
+	#include <emmintrin.h>
+	#if defined(_MSC_VER)
+		#include <intrin.h>
+		//AVX2 intrinsics are only available since msvc2013.
+		#if _MSC_VER >= 1800
+			#define GESTURE_KERNELS_AVX2 1
+			#include <immintrin.h>
+			#define AVX2_TARGET
+		#endif
+	#elif defined(__GNUC__)
+		#include <cpuid.h>
+		#include <immintrin.h>
+		#define GESTURE_KERNELS_AVX2 1
+		#define AVX2_TARGET __attribute__((target("avx2")))
+	#endif
+#endif
+
+namespace {
+	/****************Scalar.****************/
+	float ArcLengthScalar(const float *x, const float *y, int n, float start, float *out) {
+		float length = start;
+		out[0] = length;
+		for(int i=1; i<n; i++) {
+			float dx = x[i]-x[i-1], dy = y[i]-y[i-1];
+			length += sqrt(dx*dx + dy*dy);
+			out[i] = length;
+		}
+		return length;
+	}
+
+	void LerpScalar(const float *x, const float *y, const int *index, const float *t, int n, float *out_x, float *out_y) {
+		for(int i=0; i<n; i++) {
+			int k = index[i];
+			float w = t[i];
+			out_x[i] = x[k]*(1-w) + x[k+1]*w;
+			out_y[i] = y[k]*(1-w) + y[k+1]*w;
+		}
+	}
+
+	float ClampedSquareErrorScalar(const float *lx, const float *ly, const float *rx, const float *ry, int n, float clamp, float start) {
+		float error = start;
+		for(int i=0; i<n; i++) {
+			float dx = rx[i]-lx[i], dy = ry[i]-ly[i];
+			float d = dx*dx + dy*dy;
+			if(d > clamp)
+				error += d;
+		}
+		return error;
+	}
+
+#ifdef GESTURE_KERNELS_X86
+	/****************SSE2.****************/
+	//Segment lengths are independent so they go 4 at a time, the running sum stays sequential.
+	float ArcLengthSSE2(const float *x, const float *y, int n, float start, float *out) {
+		int i = 1;
+		for(; i+4<=n; i+=4) {
+			__m128 dx = _mm_sub_ps(_mm_loadu_ps(x+i), _mm_loadu_ps(x+i-1));
+			__m128 dy = _mm_sub_ps(_mm_loadu_ps(y+i), _mm_loadu_ps(y+i-1));
+			__m128 d = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)));
+			_mm_storeu_ps(out+i, d);
+		}
+		for(; i<n; i++) {
+			float dx = x[i]-x[i-1], dy = y[i]-y[i-1];
+			out[i] = sqrt(dx*dx + dy*dy);
+		}
+
+		float length = start;
+		out[0] = length;
+		for(i=1; i<n; i++) {
+			length += out[i];
+			out[i] = length;
+		}
+		return length;
+	}
+
+	void LerpSSE2(const float *x, const float *y, const int *index, const float *t, int n, float *out_x, float *out_y) {
+		__m128 one = _mm_set1_ps(1.0f);
+		int i = 0;
+		for(; i+4<=n; i+=4) {
+			const int *k = index+i;
+			__m128 x0 = _mm_setr_ps(x[k[0]], x[k[1]], x[k[2]], x[k[3]]);
+			__m128 x1 = _mm_setr_ps(x[k[0]+1], x[k[1]+1], x[k[2]+1], x[k[3]+1]);
+			__m128 y0 = _mm_setr_ps(y[k[0]], y[k[1]], y[k[2]], y[k[3]]);
+			__m128 y1 = _mm_setr_ps(y[k[0]+1], y[k[1]+1], y[k[2]+1], y[k[3]+1]);
+			__m128 w = _mm_loadu_ps(t+i);
+			__m128 w0 = _mm_sub_ps(one, w);
+			_mm_storeu_ps(out_x+i, _mm_add_ps(_mm_mul_ps(x0, w0), _mm_mul_ps(x1, w)));
+			_mm_storeu_ps(out_y+i, _mm_add_ps(_mm_mul_ps(y0, w0), _mm_mul_ps(y1, w)));
+		}
+		LerpScalar(x, y, index+i, t+i, n-i, out_x+i, out_y+i);
+	}
+
+	float ClampedSquareErrorSSE2(const float *lx, const float *ly, const float *rx, const float *ry, int n, float clamp, float start) {
+		__m128 sum = _mm_setzero_ps();
+		__m128 c = _mm_set1_ps(clamp);
+		int i = 0;
+		for(; i+4<=n; i+=4) {
+			__m128 dx = _mm_sub_ps(_mm_loadu_ps(rx+i), _mm_loadu_ps(lx+i));
+			__m128 dy = _mm_sub_ps(_mm_loadu_ps(ry+i), _mm_loadu_ps(ly+i));
+			__m128 d = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+			sum = _mm_add_ps(sum, _mm_and_ps(d, _mm_cmpgt_ps(d, c)));
+		}
+		float lanes[4];
+		_mm_storeu_ps(lanes, sum);
+		float error = start + ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3]));
+		return ClampedSquareErrorScalar(lx+i, ly+i, rx+i, ry+i, n-i, clamp, error);
+	}
+#endif			//GESTURE_KERNELS_X86
+
+#ifdef GESTURE_KERNELS_AVX2
+	/****************AVX2.****************/
+	AVX2_TARGET float ArcLengthAVX2(const float *x, const float *y, int n, float start, float *out) {
+		int i = 1;
+		for(; i+8<=n; i+=8) {
+			__m256 dx = _mm256_sub_ps(_mm256_loadu_ps(x+i), _mm256_loadu_ps(x+i-1));
+			__m256 dy = _mm256_sub_ps(_mm256_loadu_ps(y+i), _mm256_loadu_ps(y+i-1));
+			__m256 d = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)));
+			_mm256_storeu_ps(out+i, d);
+		}
+		for(; i<n; i++) {
+			float dx = x[i]-x[i-1], dy = y[i]-y[i-1];
+			out[i] = sqrt(dx*dx + dy*dy);
+		}
+
+		float length = start;
+		out[0] = length;
+		for(i=1; i<n; i++) {
+			length += out[i];
+			out[i] = length;
+		}
+		return length;
+	}
+
+	AVX2_TARGET void LerpAVX2(const float *x, const float *y, const int *index, const float *t, int n, float *out_x, float *out_y) {
+		__m256 one = _mm256_set1_ps(1.0f);
+		__m256i next = _mm256_set1_epi32(1);
+		int i = 0;
+		for(; i+8<=n; i+=8) {
+			__m256i k0 = _mm256_loadu_si256((const __m256i *)(index+i));
+			__m256i k1 = _mm256_add_epi32(k0, next);
+			__m256 w = _mm256_loadu_ps(t+i);
+			__m256 w0 = _mm256_sub_ps(one, w);
+			__m256 x0 = _mm256_i32gather_ps(x, k0, 4), x1 = _mm256_i32gather_ps(x, k1, 4);
+			__m256 y0 = _mm256_i32gather_ps(y, k0, 4), y1 = _mm256_i32gather_ps(y, k1, 4);
+			_mm256_storeu_ps(out_x+i, _mm256_add_ps(_mm256_mul_ps(x0, w0), _mm256_mul_ps(x1, w)));
+			_mm256_storeu_ps(out_y+i, _mm256_add_ps(_mm256_mul_ps(y0, w0), _mm256_mul_ps(y1, w)));
+		}
+		LerpScalar(x, y, index+i, t+i, n-i, out_x+i, out_y+i);
+	}
+
+	AVX2_TARGET float ClampedSquareErrorAVX2(const float *lx, const float *ly, const float *rx, const float *ry, int n, float clamp, float start) {
+		__m256 sum = _mm256_setzero_ps();
+		__m256 c = _mm256_set1_ps(clamp);
+		int i = 0;
+		for(; i+8<=n; i+=8) {
+			__m256 dx = _mm256_sub_ps(_mm256_loadu_ps(rx+i), _mm256_loadu_ps(lx+i));
+			__m256 dy = _mm256_sub_ps(_mm256_loadu_ps(ry+i), _mm256_loadu_ps(ly+i));
+			__m256 d = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+			sum = _mm256_add_ps(sum, _mm256_and_ps(d, _mm256_cmp_ps(d, c, _CMP_GT_OQ)));
+		}
+		float lanes[8];
+		_mm256_storeu_ps(lanes, sum);
+		float error = start + (((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) + ((lanes[4] + lanes[5]) + (lanes[6] + lanes[7])));
+		return ClampedSquareErrorScalar(lx+i, ly+i, rx+i, ry+i, n-i, clamp, error);
+	}
+#endif			//GESTURE_KERNELS_AVX2
+
+	/****************Dispatch.****************/
+	struct KernelTable {
+		float (*arc_length)(const float *, const float *, int, float, float *);
+		void (*lerp)(const float *, const float *, const int *, const float *, int, float *, float *);
+		float (*clamped_square_error)(const float *, const float *, const float *, const float *, int, float, float);
+	};
+
+	gesture_kernels::Level DetectLevel() {
+#ifdef GESTURE_KERNELS_X86
+		int regs[4] = {0, 0, 0, 0};
+	#if defined(_MSC_VER)
+		__cpuid(regs, 0);
+		int max_leaf = regs[0];
+		__cpuid(regs, 1);
+	#else
+		unsigned int a, b, c, d;
+		int max_leaf = __get_cpuid_max(0, 0);
+		__cpuid(1, a, b, c, d);
+		regs[0] = a; regs[1] = b; regs[2] = c; regs[3] = d;
+	#endif
+		if(!(regs[3] & (1<<26)))
+			return gesture_kernels::SCALAR;
+
+	#ifdef GESTURE_KERNELS_AVX2
+		//AVX needs both the cpu flag and the os saving ymm registers (osxsave + xcr0).
+		bool avx = (regs[2] & (1<<27)) && (regs[2] & (1<<28));
+		if(avx && max_leaf >= 7) {
+		#if defined(_MSC_VER)
+			unsigned long long xcr0 = _xgetbv(0);
+			__cpuidex(regs, 7, 0);
+		#else
+			unsigned int xcr0_lo, xcr0_hi;
+			__asm__ volatile("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+			unsigned long long xcr0 = ((unsigned long long)xcr0_hi << 32) | xcr0_lo;
+			__cpuid_count(7, 0, a, b, c, d);
+			regs[0] = a; regs[1] = b; regs[2] = c; regs[3] = d;
+		#endif
+			if((xcr0 & 0x6) == 0x6 && (regs[1] & (1<<5)))
+				return gesture_kernels::AVX2;
+		}
+	#else
+		(void)max_leaf;
+	#endif
+		return gesture_kernels::SSE2;
+#else
+		return gesture_kernels::SCALAR;
+#endif
+	}
+
+	KernelTable MakeTable(gesture_kernels::Level level) {
+		KernelTable table = {ArcLengthScalar, LerpScalar, ClampedSquareErrorScalar};
+#ifdef GESTURE_KERNELS_X86
+		if(level == gesture_kernels::SSE2) {
+			KernelTable sse2 = {ArcLengthSSE2, LerpSSE2, ClampedSquareErrorSSE2};
+			table = sse2;
+		}
+#endif
+#ifdef GESTURE_KERNELS_AVX2
+		if(level == gesture_kernels::AVX2) {
+			KernelTable avx2 = {ArcLengthAVX2, LerpAVX2, ClampedSquareErrorAVX2};
+			table = avx2;
+		}
+#endif
+		return table;
+	}
+
+	const gesture_kernels::Level kSupportedLevel = DetectLevel();
+	gesture_kernels::Level current_level = kSupportedLevel;
+	KernelTable kernels = MakeTable(kSupportedLevel);
+}
+
+namespace gesture_kernels {
+	Level GetSupportedLevel() {
+		return kSupportedLevel;
+	}
+
+	Level GetLevel() {
+		return current_level;
+	}
+
+	void SetLevel(Level level) {
+		current_level = level > kSupportedLevel ? kSupportedLevel : level;
+		kernels = MakeTable(current_level);
+	}
+
+	float ArcLength(const float *x, const float *y, int n, float start, float *out) {
+		if(n <= 0)
+			return start;
+		return kernels.arc_length(x, y, n, start, out);
+	}
+
+	void Lerp(const float *x, const float *y, const int *index, const float *t, int n, float *out_x, float *out_y) {
+		kernels.lerp(x, y, index, t, n, out_x, out_y);
+	}
+
+	float ClampedSquareError(const float *lhs_x, const float *lhs_y, const float *rhs_x, const float *rhs_y, int n, float clamp, float start) {
+		return kernels.clamped_square_error(lhs_x, lhs_y, rhs_x, rhs_y, n, clamp, start);
+	}
+}
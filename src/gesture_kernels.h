@@ -0,0 +1,45 @@
+#ifndef GESTURE_KERNELS_H_
+#define GESTURE_KERNELS_H_
+
+/**
+ * Vectorized kernels behind the hot loops of Gesture.
+ *
+ * All kernels work on structure-of-arrays point data, x and y are kept in two separate float arrays.
+ * The implementation is chosen once at runtime according to the cpu: AVX2, SSE2 or plain scalar code.
+ *
+ * Tolerance against the scalar path:
+ *		ArcLength and Lerp produce exactly the same floats as the scalar code, the vector
+ *		version only computes independent elements side by side and keeps the running sum sequential.
+ *		ClampedSquareError sums its lanes in a different order, so the result may differ from the
+ *		scalar sum by a relative error of at most n * FLT_EPSILON (about 1e-5 for 100 samples).
+ */
+namespace gesture_kernels {
+	enum Level {SCALAR=0, SSE2, AVX2};
+
+	//The best level supported by both the build and the cpu.
+	Level GetSupportedLevel();
+	Level GetLevel();
+
+	//Mainly for comparing against the scalar path. Anything above GetSupportedLevel() is clamped.
+	void SetLevel(Level level);
+
+	/**
+	 * out[0] = start and out[i] = out[i-1] + distance between point i-1 and point i.
+	 * Return the total length, which is out[n-1].
+	 */
+	float ArcLength(const float *x, const float *y, int n, float start, float *out);
+
+	/**
+	 * Linear interpolation between point index[i] and index[i]+1 with weight t[i].
+	 * out_x[i] = x[index[i]]*(1-t[i]) + x[index[i]+1]*t[i], same for y.
+	 */
+	void Lerp(const float *x, const float *y, const int *index, const float *t, int n, float *out_x, float *out_y);
+
+	/**
+	 * Sum of squared distance between point pairs, any squared distance no greater than clamp is ignored.
+	 * The sum starts from start, so a long run can be accumulated in several calls.
+	 */
+	float ClampedSquareError(const float *lhs_x, const float *lhs_y, const float *rhs_x, const float *rhs_y, int n, float clamp, float start);
+}
+
+#endif			//GESTURE_KERNELS_H_
@@ -0,0 +1,184 @@
+#include "gesture_library.h"
+#include "gesture.h"
+
+#include <fstream>
+#include <string.h>
+
+static const char kMagic[4] = {'O', 'G', 'L', 'B'};
+static const uint32_t kByteOrder = 0x01020304;
+static const uint64_t kAlignment = 64;
+
+static uint64_t Align(uint64_t offset) {
+	return (offset+kAlignment-1)/kAlignment*kAlignment;
+}
+
+//Whether [offset, offset+bytes) lies in a file of size bytes, without overflowing.
+static bool InRange(uint64_t offset, uint64_t bytes, uint64_t size) {
+	return offset <= size && bytes <= size-offset;
+}
+
+GestureLibrary::GestureLibrary() : header(0), entries(0), strings(0), xs(0), ys(0), lengths(0) {
+
+}
+
+GestureLibrary::~GestureLibrary() {
+	Close();
+}
+
+bool GestureLibrary::IsLibrary(const std::string &file_name) {
+	std::ifstream file(file_name.c_str(), std::ios::binary);
+	char magic[sizeof(kMagic)];
+	if(!file.read(magic, sizeof(magic)))
+		return false;
+	return memcmp(magic, kMagic, sizeof(kMagic)) == 0;
+}
+
+bool GestureLibrary::Open(const std::string &file_name) {
+	Close();
+	if(!file.Open(file_name))
+		return false;
+	header = (const Header *)file.Data();
+	if(!Check()) {
+		Close();
+		return false;
+	}
+	const char *base = file.Data();
+	entries = (const Entry *)(base+header->entries_offset);
+	strings = base+header->strings_offset;
+	xs = (const float *)(base+header->xs_offset);
+	ys = (const float *)(base+header->ys_offset);
+	lengths = header->flags & kHasLengths ? (const float *)(base+header->lengths_offset) : 0;
+	return true;
+}
+
+void GestureLibrary::Close() {
+	file.Close();
+	header = 0;
+	entries = 0;
+	strings = 0;
+	xs = ys = lengths = 0;
+}
+
+bool GestureLibrary::Check() const {
+	uint64_t size = file.Size();
+	if(size < sizeof(Header))
+		return false;
+	const Header &h = *header;
+	if(memcmp(h.magic, kMagic, sizeof(kMagic)) != 0 || h.byte_order != kByteOrder || h.version != kVersion)
+		return false;
+	if(h.flags & ~(uint32_t)kHasLengths)
+		return false;
+
+	//Sections, the mapping is page aligned so aligned offsets give aligned pointers.
+	if(h.entries_offset%sizeof(uint64_t) != 0 || !InRange(h.entries_offset, (uint64_t)h.count*sizeof(Entry), size))
+		return false;
+	if(!InRange(h.strings_offset, h.string_size, size))
+		return false;
+	if(h.point_count > size/sizeof(float))
+		return false;
+	uint64_t point_bytes = h.point_count*sizeof(float);
+	if(h.xs_offset%sizeof(float) != 0 || !InRange(h.xs_offset, point_bytes, size))
+		return false;
+	if(h.ys_offset%sizeof(float) != 0 || !InRange(h.ys_offset, point_bytes, size))
+		return false;
+	if(h.flags & kHasLengths) {
+		if(h.lengths_offset%sizeof(float) != 0 || !InRange(h.lengths_offset, point_bytes, size))
+			return false;
+	}
+
+	const Entry *e = (const Entry *)(file.Data()+h.entries_offset);
+	for(uint32_t i=0; i<h.count; i++) {
+		if(!InRange(e[i].name_offset, e[i].name_size, h.string_size))
+			return false;
+		if(!InRange(e[i].first, e[i].size, h.point_count))
+			return false;
+	}
+	return true;
+}
+
+std::string GestureLibrary::GetName(int i) const {
+	const Entry &e = entries[i];
+	return std::string(strings+e.name_offset, e.name_size);
+}
+
+void GestureLibrary::View(int i, Gesture *g) const {
+	const Entry &e = entries[i];
+	g->View(xs+e.first, ys+e.first, lengths ? lengths+e.first : 0, (int)e.size,
+		Gesture::Point(e.anchor_x, e.anchor_y),
+		Gesture::Point(e.box_min_x, e.box_min_y), Gesture::Point(e.box_max_x, e.box_max_y));
+}
+
+bool GestureLibrary::Write(const std::string &file_name, const Gestures &gestures, bool with_lengths) {
+	Header h;
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, kMagic, sizeof(kMagic));
+	h.version = kVersion;
+	h.byte_order = kByteOrder;
+	h.flags = with_lengths ? kHasLengths : 0;
+	h.count = (uint32_t)gestures.size();
+
+	std::vector<Entry> entries(gestures.size());
+	std::string strings;
+	std::vector<float> xs, ys, lengths;
+	for(int i=0; i<gestures.size(); i++) {
+		const std::string &name = gestures[i].first;
+		const Gesture *g = gestures[i].second;
+		Entry &e = entries[i];
+		memset(&e, 0, sizeof(e));
+		e.name_offset = (uint32_t)strings.size();
+		e.name_size = (uint32_t)name.size();
+		strings += name;
+		e.first = xs.size();
+		e.size = g->Size();
+		Gesture::Point anchor = g->GetAnchor();
+		e.anchor_x = anchor.x;
+		e.anchor_y = anchor.y;
+		Gesture::Point box_min = g->Size() > 0 ? g->Get(0) : Gesture::Point(), box_max = box_min;
+		for(int j=0; j<g->Size(); j++) {
+			Gesture::Point p = g->Get(j);
+			xs.push_back(p.x);
+			ys.push_back(p.y);
+			lengths.push_back(g->LengthAt(j));
+			box_min.x = p.x < box_min.x ? p.x : box_min.x;
+			box_min.y = p.y < box_min.y ? p.y : box_min.y;
+			box_max.x = p.x > box_max.x ? p.x : box_max.x;
+			box_max.y = p.y > box_max.y ? p.y : box_max.y;
+		}
+		e.box_min_x = box_min.x;
+		e.box_min_y = box_min.y;
+		e.box_max_x = box_max.x;
+		e.box_max_y = box_max.y;
+	}
+	h.string_size = (uint32_t)strings.size();
+	h.point_count = xs.size();
+
+	uint64_t point_bytes = h.point_count*sizeof(float);
+	h.entries_offset = sizeof(Header);
+	h.strings_offset = h.entries_offset + entries.size()*sizeof(Entry);
+	h.xs_offset = Align(h.strings_offset + strings.size());
+	h.ys_offset = Align(h.xs_offset + point_bytes);
+	h.lengths_offset = with_lengths ? Align(h.ys_offset + point_bytes) : 0;
+
+	std::ofstream file(file_name.c_str(), std::ios::binary);
+	if(!file.is_open())
+		return false;
+	//Zeros up to offset.
+	const char padding[kAlignment] = {0};
+	file.write((const char *)&h, sizeof(h));
+	if(!entries.empty())
+		file.write((const char *)&entries[0], entries.size()*sizeof(Entry));
+	file.write(strings.data(), strings.size());
+	file.write(padding, h.xs_offset-h.strings_offset-strings.size());
+	if(!xs.empty())
+		file.write((const char *)&xs[0], point_bytes);
+	file.write(padding, h.ys_offset-h.xs_offset-point_bytes);
+	if(!ys.empty())
+		file.write((const char *)&ys[0], point_bytes);
+	if(with_lengths) {
+		file.write(padding, h.lengths_offset-h.ys_offset-point_bytes);
+		if(!lengths.empty())
+			file.write((const char *)&lengths[0], point_bytes);
+	}
+	file.close();
+	return !file.fail();
+}
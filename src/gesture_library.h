@@ -0,0 +1,94 @@
+#ifndef GESTURE_LIBRARY_H_
+#define GESTURE_LIBRARY_H_
+
+#include "mapped_file.h"
+
+#include <string>
+#include <vector>
+#include <utility>
+
+#include <stdint.h>
+
+class Gesture;
+
+/**
+ * Binary container of template gestures, which is mapped and used in place so that loading does not parse or copy
+ * any point. Gestures made by View() read their points straight from the mapping.
+ *
+ * Layout, every number in the byte order of the machine that wrote it, which is checked on Open:
+ *		Header
+ *		Entry[count]
+ *		string table, names one after another without terminator
+ *		xs[point_count], ys[point_count] and, if kHasLengths, lengths[point_count], each 64 bytes aligned
+ * Points of a gesture are contiguous in each array and relative to its anchor, the way Gesture stores them.
+ * The version is bumped on any incompatible change.
+ */
+class GestureLibrary {
+public:
+	typedef std::vector<std::pair<std::string, const Gesture *> > Gestures;
+
+	enum {kVersion = 1};
+	enum {kHasLengths = 1};			//Header flags.
+
+private:
+	struct Header {
+		char magic[4];
+		uint32_t version;
+		uint32_t byte_order;
+		uint32_t flags;
+		uint32_t count;
+		uint32_t string_size;
+		uint64_t point_count;
+		//Offsets from the beginning of the file, lengths_offset is 0 without kHasLengths.
+		uint64_t entries_offset;
+		uint64_t strings_offset;
+		uint64_t xs_offset;
+		uint64_t ys_offset;
+		uint64_t lengths_offset;
+	};
+
+	struct Entry {
+		uint32_t name_offset;		//Into the string table.
+		uint32_t name_size;
+		uint64_t first;				//Index of the first point.
+		uint32_t size;
+		float anchor_x, anchor_y;
+		float box_min_x, box_min_y, box_max_x, box_max_y;
+		uint32_t reserved;
+	};
+
+public:
+	GestureLibrary();
+	~GestureLibrary();
+
+	//Cheap check on the magic, to tell a library from a text file.
+	static bool IsLibrary(const std::string &file_name);
+
+	//Map file_name and check that it is well formed. Return false if it is not a valid library.
+	bool Open(const std::string &file_name);
+	void Close();
+
+	int Size() const { return header ? (int)header->count : 0; }
+	std::string GetName(int i) const;
+	//Make g a view of gesture i, @see Gesture::View(). It stays valid until the library is closed.
+	void View(int i, Gesture *g) const;
+
+	//Write gestures as a library. Arc lengths are stored if with_lengths, which saves computing them on loading.
+	static bool Write(const std::string &file_name, const Gestures &gestures, bool with_lengths = true);
+
+private:
+	//Not copyable.
+	GestureLibrary(const GestureLibrary &);
+	void operator=(const GestureLibrary &);
+
+	bool Check() const;
+
+private:
+	MappedFile file;
+	const Header *header;
+	const Entry *entries;
+	const char *strings;
+	const float *xs, *ys, *lengths;
+};
+
+#endif			//GESTURE_LIBRARY_H_
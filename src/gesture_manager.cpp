@@ -2,102 +2,191 @@
 #include "gesture.h"
 
 #include <fstream>
-#include <assert.h>
-#include <stdlib.h>
+#include <set>
+#include <sstream>
 
-GestureManager::GestureManager() {
+static std::string FormatError(const GestureParser::Error &e) {
+	std::ostringstream stream;
+	stream<<"line "<<e.line<<", column "<<e.column<<": "<<e.message;
+	return stream.str();
+}
+
+GestureManager::GestureManager() : store(0), snapshot(0), stale(false), tolerance(0.0f), simplified(0), max_resident(0) {
+
+}
 
+template<class T> void GestureManager::Retire(T *t) {
+	if(snapshot)
+		snapshot->Retire(t);
+	else
+		delete t;
 }
 
 GestureManager::~GestureManager() {
 	for(GestureMap::const_iterator it=gestures.cbegin(); it!= gestures.cend(); it++) {
-		delete it->second;
+		Retire(it->second);
+	}
+	for(int i=0; i<replaced.size(); i++) {
+		Retire(replaced[i]);
+	}
+	if(store)
+		Retire(store);
+	for(int i=0; i<libraries.size(); i++) {
+		Retire(libraries[i]);
 	}
+	if(snapshot)
+		snapshot->Release();
+	Close();
 }
 
-bool GestureManager::Load(const std::string &file_name) {
-	//TODO: Add better error checking.
-	std::ifstream file;
-	file.open(file_name);
-	if(!file.is_open()) {
-		file.close();
+bool GestureManager::Load(const std::string &file_name, WorkerPool *pool) {
+	error.clear();
+	simplified = 0;
+	if(GestureLibrary::IsLibrary(file_name))
+		return LoadBinary(file_name);
+	return LoadText(file_name, pool);
+}
+
+bool GestureManager::LoadBinary(const std::string &file_name) {
+	GestureLibrary *library = new GestureLibrary;
+	if(!library->Open(file_name)) {
+		error = "not a valid gesture library";
+		delete library;
 		return false;
 	}
-	while(!file.eof()) {
-		char *temp;
-		std::string name;
-		getline(file, name);
-		if(name == "")
-			continue;
-		std::string size_str;
-		if(file.eof())
-			return false;
-		getline(file, size_str);
-		int s = (int)strtol(size_str.c_str(), &temp, 0);
-		if(*temp != '\0')
-			return false;
-		std::string buf;
-		if(file.eof())
-			return false;
-		getline(file, buf);
-		Gesture *gesture = new Gesture;
-		int p = 0;
-		for(int i=0; i<s; i++) {
-			int q = p;
-			bool error = false;
-			while(buf[q] != ' ' && buf[q] != '\t') {
-				if(buf[q] == '\0') {
-					error = true;
-					break;
-				}
-				q++;
-			}
-			if(error) {
-				delete gesture;
-				return false;
-			}
-			float x = (float)strtod(buf.substr(p, q-p).c_str(), &temp);
-			if(*temp != 0) {
-				delete gesture;
-				return false; 
-			}
-			p = ++q;
-			while(buf[q] != ' ' && buf[q] != '\t') {
-				if(buf[q] == '\0') {
-					error = true;
-					break;
-				}
-				q++;
-			}
-			if(error) {
-				delete gesture;
-				return false;
-			}
-			float y = (float)strtod(buf.substr(p, q-p).c_str(), &temp);
-			if(*temp != 0) {
-				delete gesture;
-				return false;
+	libraries.push_back(library);
+	Merge(GestureParser::Gestures(), library);
+	return true;
+}
+
+bool GestureManager::LoadText(const std::string &file_name, WorkerPool *pool) {
+	MappedFile file;
+	if(!file.Open(file_name)) {
+		error = "cannot open file";
+		return false;
+	}
+	GestureParser::Gestures parsed;
+	GestureParser::Error e;
+	if(!GestureParser::Parse(file.Data(), file.Size(), pool, &parsed, &e, tolerance, &simplified)) {
+		error = FormatError(e);
+		return false;
+	}
+	Merge(parsed, 0);
+	for(int i=0; i<parsed.size(); i++) {
+		delete parsed[i].second;
+	}
+	return true;
+}
+
+void GestureManager::Merge(const GestureParser::Gestures &loaded, const GestureLibrary *library) {
+	int count = loaded.size() + (library ? library->Size() : 0), points = 0;
+	if(store) {
+		for(int i=0; i<store->Size(); i++) {
+			if(!store->IsRemoved(i)) {
+				count++;
+				points += store->IsCopied(i) ? store->Get(i)->Size() : 0;
 			}
-			p = ++q;
-			gesture->PushBack(x, y);
 		}
-		assert(gesture->Size() == s);
-		gestures[name] = gesture;
 	}
-	file.close();
-	return true;
+	for(int i=0; i<loaded.size(); i++) {
+		points += loaded[i].second->Size();
+	}
+
+	GestureStore *merged = new GestureStore;
+	merged->Reserve(count, points);
+	if(store) {
+		for(int i=0; i<store->Size(); i++) {
+			if(!store->IsRemoved(i))
+				merged->Add(*store, i);
+		}
+	}
+	for(int i=0; i<loaded.size(); i++) {
+		merged->Add(loaded[i].first, *loaded[i].second);
+	}
+	if(library) {
+		for(int i=0; i<library->Size(); i++) {
+			merged->Add(library->GetName(i), library, i);
+		}
+	}
+	merged->Finish();
+	if(store)
+		Retire(store);
+	store = merged;
+
+	//Libraries whose every gesture got replaced are not needed any more, their mappings go with the old store.
+	std::set<const GestureLibrary *> used;
+	for(int i=0; i<store->Size(); i++) {
+		if(!store->IsRemoved(i) && store->GetLibrary(i))
+			used.insert(store->GetLibrary(i));
+	}
+	for(int i=0; i<libraries.size();) {
+		if(used.count(libraries[i])) {
+			i++;
+			continue;
+		}
+		Retire(libraries[i]);
+		libraries.erase(libraries.begin()+i);
+	}
+
+	//Loaded gestures replace put ones of the same name.
+	for(GestureMap::iterator it=gestures.begin(); it!=gestures.end();) {
+		if(store->Find(it->first) != -1) {
+			Retire(it->second);
+			gestures.erase(it++);
+		}
+		else {
+			it++;
+		}
+	}
+	BuildIndex();
+	Publish();
+}
+
+void GestureManager::BuildIndex() {
+	std::vector<std::pair<std::string, const Gesture *> > all;
+	GetAll(&all);
+	index.Build(all);
+	for(int i=0; i<replaced.size(); i++) {
+		Retire(replaced[i]);
+	}
+	replaced.clear();
+}
+
+void GestureManager::Publish() {
+	GestureSnapshot *s = new GestureSnapshot(index);
+	if(snapshot) {
+		snapshot->SetNext(s);
+		snapshot->Release();
+	}
+	snapshot = s;
+	stale = false;
+}
+
+const GestureSnapshot *GestureManager::GetSnapshot() {
+	if(!snapshot || stale)
+		Publish();
+	snapshot->AddRef();
+	return snapshot;
 }
 
-bool GestureManager::Save(const std::string &file_name) const {
+bool GestureManager::Save(const std::string &file_name, Format format) const {
+	if(format == LIBRARY) {
+		std::vector<std::pair<std::string, const Gesture *> > all;
+		GetAll(&all);
+		return GestureLibrary::Write(file_name, all);
+	}
+
 	std::ofstream file;
 	file.open(file_name);
 	if(!file.is_open()) {
 		file.close();
 		return false;
 	}
-	for(GestureMap::const_iterator it=gestures.cbegin(); it!= gestures.cend(); it++) {
-		file<<it->first<<"\n";
-		const  Gesture *cur = it->second;
+	std::vector<std::pair<std::string, const Gesture *> > all;
+	GetAll(&all);
+	for(int j=0; j<all.size(); j++) {
+		file<<all[j].first<<"\n";
+		const  Gesture *cur = all[j].second;
 		file<<cur->Size()<<"\n";
 		for(int i=0; i<cur->Size(); i++) {
 			const Gesture::Point &p = cur->Get(i);
@@ -110,19 +199,131 @@ bool GestureManager::Save(const std::string &file_name) const {
 }
 
 void GestureManager::Put(const std::string &name, Gesture *g) {
+	//A descriptor is dropped on any change to the points, so one that is there is up to date.
+	if(!g->GetDescriptor())
+		g->BuildDescriptor();
+	//Only marks the entry, the gesture stays where snapshots see it.
+	int i = store ? store->Find(name) : -1;
+	if(i != -1) {
+		index.Remove(store->Get(i));
+		store->Remove(i);
+	}
+	//Removed templates may still be vantage points of the index, so they are kept until it is built again.
+	GestureMap::iterator it = gestures.find(name);
+	if(it != gestures.end()) {
+		index.Remove(it->second);
+		replaced.push_back(it->second);
+	}
 	gestures[name] = g;
+	index.Insert(name, g);
+	//Once removed templates are the most, the index is built again without them.
+	if(index.Size() > 2*index.LiveSize())
+		BuildIndex();
+	stale = true;
+}
+
+const Gesture* GestureManager::Get(const std::string& name) {
+	GestureMap::iterator it = gestures.find(name);
+	if(it != gestures.end())
+		return it->second;
+	int i = store ? store->Find(name) : -1;
+	if(i != -1)
+		return store->Get(i);
+	LazyMap::iterator l = lazy.find(name);
+	if(l != lazy.end())
+		return Build(&l->second);
+	return 0;
+}
+
+bool GestureManager::Open(const std::string &file_name, int _max_resident) {
+	Close();
+	error.clear();
+	max_resident = _max_resident;
+	if(GestureLibrary::IsLibrary(file_name)) {
+		if(!library.Open(file_name)) {
+			error = "not a valid gesture library";
+			return false;
+		}
+		//Only the entries and the names are touched, the points stay on disk until used.
+		for(int i=0; i<library.Size(); i++) {
+			lazy[library.GetName(i)].source = i;
+		}
+		return true;
+	}
+
+	if(!text.Open(file_name)) {
+		error = "cannot open file";
+		return false;
+	}
+	GestureParser::Error e;
+	if(!GestureParser::Scan(text.Data(), text.Size(), &records, &e)) {
+		error = FormatError(e);
+		Close();
+		return false;
+	}
+	for(int i=0; i<records.size(); i++) {
+		const GestureParser::Record &r = records[i];
+		lazy[std::string(r.name, r.name_size)].source = i;
+	}
+	return true;
+}
+
+void GestureManager::Close() {
+	for(std::list<Lazy *>::iterator it=resident.begin(); it!=resident.end(); it++) {
+		delete (*it)->gesture;
+	}
+	resident.clear();
+	lazy.clear();
+	records.clear();
+	text.Close();
+	library.Close();
 }
 
-Gesture* GestureManager::Get(const std::string& name) {
-	return gestures[name];
+Gesture *GestureManager::Build(Lazy *l) {
+	if(l->gesture) {
+		resident.splice(resident.begin(), resident, l->position);
+		return l->gesture;
+	}
+
+	Gesture *g = new Gesture;
+	if(library.Size() > 0) {
+		library.View(l->source, g);
+		g->BuildDescriptor();
+	}
+	else {
+		GestureParser::Error e;
+		if(!GestureParser::ParseRecord(records[l->source], g, &e, tolerance)) {
+			error = FormatError(e);
+			delete g;
+			return 0;
+		}
+	}
+	l->gesture = g;
+	resident.push_front(l);
+	l->position = resident.begin();
+
+	if(max_resident > 0 && resident.size() > max_resident) {
+		Lazy *victim = resident.back();
+		resident.pop_back();
+		delete victim->gesture;
+		victim->gesture = 0;
+	}
+	return g;
 }
 
-void GestureManager::GetAll(std::vector<std::pair<std::string, Gesture *> > *result) const {
+void GestureManager::GetAll(std::vector<std::pair<std::string, const Gesture *> > *result) const {
+	if(store) {
+		result->reserve(result->size() + store->LiveSize() + gestures.size());
+		for(int i=0; i<store->Size(); i++) {
+			if(!store->IsRemoved(i))
+				result->push_back(std::make_pair(store->GetName(i), store->Get(i)));
+		}
+	}
 	for(GestureMap::const_iterator it=gestures.cbegin(); it!= gestures.cend(); it++) {
 		result->push_back(std::make_pair(it->first, it->second));
 	}
 }
 
 int GestureManager::Size() const {
-	return gestures.size();
+	return (store ? store->LiveSize() : 0) + gestures.size();
 }
\ No newline at end of file
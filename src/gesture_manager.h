@@ -1,33 +1,128 @@
 #ifndef GESTURE_MANAGER_H_
 #define GESTURE_MANAGER_H_
 
+#include "gesture_index.h"
+#include "gesture_library.h"
+#include "gesture_parser.h"
+#include "gesture_snapshot.h"
+#include "gesture_store.h"
+#include "mapped_file.h"
+
+#include <list>
 #include <map>
 #include <string>
 #include <vector>
 #include <utility>
 
 class Gesture;
+class WorkerPool;
 
 //A simple manager to do serialization and deserialization.
 class GestureManager {
 private:
 	typedef std::map<std::string, Gesture *> GestureMap;
 
+	//A gesture of the opened file, built on its first Get.
+	struct Lazy {
+		int source;					//Entry of the library or record of the text.
+		Gesture *gesture;			//0 if not resident.
+		std::list<Lazy *>::iterator position;		//In resident, if it is.
+
+		Lazy() : source(-1), gesture(0) {}
+	};
+	typedef std::map<std::string, Lazy> LazyMap;
+
 public:
+	enum Format {
+		TEXT,			//Name, point count and coordinates on three lines per gesture.
+		LIBRARY			//@see GestureLibrary.
+	};
+
 	GestureManager();
 	~GestureManager();
 
-	bool Load(const std::string &file_name);
-	bool Save(const std::string &file_name) const;
+	/**
+	 * Either format, told apart by content. Gestures of a library are views into the mapped file, kept open until
+	 * destroyed. Text is parsed spread over pool if given. On failure GetError() tells why, e.g. line and column.
+	 * Loaded gestures go to a GestureStore, which is rebuilt together with the ones loaded before, so pointers to
+	 * loaded gestures from Get and GetAll are only valid until the next Load. Snapshots stay valid, @see GetSnapshot().
+	 */
+	bool Load(const std::string &file_name, WorkerPool *pool = 0);
+	const std::string &GetError() const { return error; }
+	/**
+	 * Simplify the points of gestures loaded or opened from text from now on, within tolerance pixels
+	 * (@see simplify::Rdp), 0 to keep every point. Libraries hold whatever was saved into them.
+	 */
+	void SetSimplify(float _tolerance) { tolerance = _tolerance; }
+	//Points simplified away by the last Load.
+	int Simplified() const { return simplified; }
+	/**
+	 * Lazy alternative to Load. file_name is scanned once for the name and place of each gesture, which is only built
+	 * on its first Get, so startup time and memory depend on the gestures used rather than on the file size.
+	 * At most max_resident gestures are kept built, the least recently used one is dropped beyond that, 0 for no bound.
+	 * Replaces the file opened before. Opened gestures are only reached by Get: GetAll, Size and snapshots only cover
+	 * the ones loaded or put.
+	 */
+	bool Open(const std::string &file_name, int max_resident = 0);
+	//Number of gestures opened, built or not.
+	int OpenedSize() const { return lazy.size(); }
+	//Loading a file and saving it in the other format converts it.
+	bool Save(const std::string &file_name, Format format = TEXT) const;
 
-	//Will delete g when destroyed.
+	/**
+	 * Will delete g once neither the manager nor any snapshot has it. g is a template from now on and must not change,
+	 * its Descriptor is built here unless it has one.
+	 */
 	void Put(const std::string &name, Gesture *g);
-	Gesture* Get(const std::string &name);
-	void GetAll(std::vector<std::pair<std::string, Gesture *> > *result) const;
+	/**
+	 * Loaded or put gestures first, then opened ones. Return 0 if there is none or it fails to build.
+	 * With a bound on resident gestures, an opened one stays valid until max_resident other ones are got after it.
+	 * Getting an opened gesture modifies the manager, so it is not thread safe.
+	 */
+	const Gesture* Get(const std::string &name);
+	void GetAll(std::vector<std::pair<std::string, const Gesture *> > *result) const;
 	int Size() const;
+	/**
+	 * The templates loaded or put so far and their index, with a reference for the caller to Release().
+	 * Load builds the index and makes a new snapshot right away. Put updates the index in place, and the next call
+	 * copies it into a new snapshot.
+	 * A snapshot never changes and outlives whatever the manager does afterwards, the manager itself included.
+	 */
+	const GestureSnapshot *GetSnapshot();
 
 private:
-	GestureMap gestures;	
+	bool LoadText(const std::string &file_name, WorkerPool *pool);
+	bool LoadBinary(const std::string &file_name);
+	//Replace store with one holding its gestures and then the loaded ones, library is where these are viewed from.
+	void Merge(const GestureParser::Gestures &loaded, const GestureLibrary *library);
+	//Build index again from the templates now, without the removed ones.
+	void BuildIndex();
+	//Replace snapshot with one of index.
+	void Publish();
+	//Free what the manager no longer uses once no snapshot can see it.
+	template<class T> void Retire(T *t);
+	void Close();
+	Gesture *Build(Lazy *lazy);
+
+private:
+	GestureStore *store;	//Loaded gestures, 0 until the first Load.
+	GestureMap gestures;	//Put ones.
+	GestureIndex index;				//Of the templates now, copied into each snapshot.
+	std::vector<Gesture *> replaced;	//Put ones replaced since index was built, its trees may still use them.
+	GestureSnapshot *snapshot;		//Latest, 0 until the first Load or GetSnapshot.
+	bool stale;						//index changed since snapshot was made.
+	std::vector<GestureLibrary *> libraries;	//Backing the gestures loaded from them.
+	std::string error;							//Why the last Load failed.
+	float tolerance;
+	int simplified;
+
+	//Opened file, one of them is in use.
+	MappedFile text;
+	std::vector<GestureParser::Record> records;
+	GestureLibrary library;
+	LazyMap lazy;
+	std::list<Lazy *> resident;					//Most recently used first.
+	int max_resident;
 };
 
 #endif				//GESTURE_MANAGER_H_
\ No newline at end of file
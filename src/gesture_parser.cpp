@@ -0,0 +1,342 @@
+#include "gesture_parser.h"
+#include "gesture.h"
+#include "simplify.h"
+#include "worker_pool.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static const int kChunkSize = 16;			//Gestures per chunk of the pool.
+
+namespace {
+	//Where parsing the points of a record failed, error_at is 0 if it did not.
+	struct Failure {
+		const char *error_at;
+		const char *message;
+
+		Failure() : error_at(0), message(0) {}
+	};
+
+	inline bool IsSpace(char c) {
+		return c == ' ' || c == '\t' || c == '\r';
+	}
+
+	inline bool IsDigit(char c) {
+		return c >= '0' && c <= '9';
+	}
+
+	//End of the line starting at p, the "\n" or end.
+	inline const char *LineEnd(const char *p, const char *end) {
+		const char *eol = (const char *)memchr(p, '\n', end-p);
+		return eol ? eol : end;
+	}
+
+	inline const char *TrimRight(const char *begin, const char *end) {
+		while(end > begin && IsSpace(end[-1]))
+			end--;
+		return end;
+	}
+}
+
+//Powers of ten exactly representable in a double.
+static const double kPow10[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/**
+ * Fast path of ParseFloat, scanning a plain decimal number from p on up to the first character that is not part of it.
+ * If the mantissa fits in a double and so does the power of ten, one multiplication or division gives the correctly
+ * rounded double, the same strtod gives. Return false for anything else, which needs strtod.
+ */
+static inline bool ScanFloat(const char *p, const char *end, float *value, const char **stop) {
+	bool negative = false;
+	if(p < end && (*p == '-' || *p == '+')) {
+		negative = *p == '-';
+		p++;
+	}
+	unsigned long long mantissa = 0;
+	int digits = 0, exponent = 0;
+	const char *first = p;
+	for(; p < end && IsDigit(*p); p++) {
+		mantissa = mantissa*10 + (*p-'0');
+	}
+	digits = p-first;
+	if(p < end && *p == '.') {
+		const char *fraction = ++p;
+		for(; p < end && IsDigit(*p); p++) {
+			mantissa = mantissa*10 + (*p-'0');
+		}
+		digits += p-fraction;
+		exponent = -(int)(p-fraction);
+	}
+	//Up to 19 digits never overflow the mantissa, longer ones go to strtod.
+	if(digits == 0 || digits > 19)
+		return false;
+	if(p < end && (*p == 'e' || *p == 'E')) {
+		p++;
+		bool negative_exponent = false;
+		if(p < end && (*p == '-' || *p == '+')) {
+			negative_exponent = *p == '-';
+			p++;
+		}
+		if(p == end || !IsDigit(*p))
+			return false;
+		int e = 0;
+		for(; p < end && IsDigit(*p); p++) {
+			e = e < 100000 ? e*10 + (*p-'0') : e;
+		}
+		exponent += negative_exponent ? -e : e;
+	}
+	if(mantissa >= (1ULL<<53) || exponent < -22 || exponent > 22)
+		return false;
+
+	double d = (double)mantissa;
+	if(exponent < 0)
+		d /= kPow10[-exponent];
+	else if(exponent > 0)
+		d *= kPow10[exponent];
+	*value = (float)(negative ? -d : d);
+	*stop = p;
+	return true;
+}
+
+bool GestureParser::ParseFloat(const char *begin, const char *end, float *value) {
+	const char *stop;
+	if(ScanFloat(begin, end, value, &stop) && stop == end)
+		return true;
+
+	//Rare: long mantissas, huge exponents, inf, nan, hex. strtod needs a terminated copy.
+	char buf[64];
+	std::string long_buf;
+	const char *s = buf;
+	size_t size = end-begin;
+	if(size == 0)
+		return false;
+	if(size < sizeof(buf)) {
+		memcpy(buf, begin, size);
+		buf[size] = '\0';
+	}
+	else {
+		long_buf.assign(begin, end);
+		s = long_buf.c_str();
+	}
+	char *temp;
+	double d = strtod(s, &temp);
+	if(temp != s+size)
+		return false;
+	*value = (float)d;
+	return true;
+}
+
+//Parse the points of a record, fill failure on error.
+static bool ParsePoints(const GestureParser::Record &r, std::vector<float> *xs, std::vector<float> *ys, Failure *failure) {
+	//Every coordinate takes two characters at least, so a corrupt count does not allocate more than the text holds.
+	if((r.points_end-r.points+1)/4 < r.count) {
+		failure->error_at = r.points_end;
+		failure->message = "fewer coordinates than the number of points";
+		return false;
+	}
+	xs->resize(r.count);
+	ys->resize(r.count);
+	const char *p = r.points, *end = r.points_end;
+	for(int i=0; i<r.count*2; i++) {
+		while(p < end && IsSpace(*p))
+			p++;
+		if(p == end) {
+			failure->error_at = p;
+			failure->message = "fewer coordinates than the number of points";
+			return false;
+		}
+		//Plain numbers are parsed in the same pass that finds where they end.
+		float v;
+		const char *q;
+		if(!ScanFloat(p, end, &v, &q) || (q < end && !IsSpace(*q))) {
+			q = p;
+			while(q < end && !IsSpace(*q))
+				q++;
+			if(!GestureParser::ParseFloat(p, q, &v)) {
+				failure->error_at = p;
+				failure->message = "expected a number";
+				return false;
+			}
+		}
+		(i%2 == 0 ? (*xs)[i/2] : (*ys)[i/2]) = v;
+		p = q;
+	}
+	while(p < end && IsSpace(*p))
+		p++;
+	if(p != end) {
+		failure->error_at = p;
+		failure->message = "more coordinates than the number of points";
+		return false;
+	}
+	return true;
+}
+
+//Parse the points of r into g, simplified within tolerance, and build its Descriptor. Add the points simplified away
+//to simplified.
+static bool Build(const GestureParser::Record &r, float tolerance, Gesture *g, std::vector<float> *xs, std::vector<float> *ys,
+		int *simplified, Failure *failure) {
+	if(!ParsePoints(r, xs, ys, failure))
+		return false;
+	if(r.count > 0) {
+		int count = simplify::Rdp(&(*xs)[0], &(*ys)[0], r.count, tolerance);
+		*simplified += r.count-count;
+		g->Append(&(*xs)[0], &(*ys)[0], count);
+	}
+	g->BuildDescriptor();
+	return true;
+}
+
+static void SetError(const GestureParser::Record &r, const Failure &failure, GestureParser::Error *error) {
+	error->line = r.line+2;
+	error->column = (int)(failure.error_at-r.points)+1;
+	error->message = failure.message;
+}
+
+class GestureParser::ParseTask : public WorkerPool::Task {
+public:
+	ParseTask(const std::vector<Record> &_records, const std::vector<Gesture *> &_gestures, float _tolerance)
+		: records(_records), gestures(_gestures), tolerance(_tolerance), failures(_records.size()),
+		simplified(_records.size(), 0) {}
+
+	virtual void Run(int chunk, int begin, int end) {
+		std::vector<float> xs, ys;
+		for(int i=begin; i<end; i++) {
+			Build(records[i], tolerance, gestures[i], &xs, &ys, &simplified[i], &failures[i]);
+		}
+	}
+
+	const std::vector<Failure> &GetFailures() const { return failures; }
+	int Simplified() const {
+		int sum = 0;
+		for(int i=0; i<simplified.size(); i++) {
+			sum += simplified[i];
+		}
+		return sum;
+	}
+
+private:
+	const std::vector<Record> &records;
+	const std::vector<Gesture *> &gestures;
+	float tolerance;
+	std::vector<Failure> failures;
+	std::vector<int> simplified;		//Per record, so that chunks do not share a counter.
+};
+
+bool GestureParser::ParseRecord(const Record &record, Gesture *g, Error *error, float tolerance, int *simplified) {
+	std::vector<float> xs, ys;
+	Failure failure;
+	int count = 0;
+	if(Build(record, tolerance, g, &xs, &ys, &count, &failure)) {
+		if(simplified)
+			*simplified = count;
+		return true;
+	}
+	SetError(record, failure, error);
+	return false;
+}
+
+bool GestureParser::Scan(const char *data, size_t size, std::vector<Record> *records, Error *error) {
+	const char *p = data, *end = data+size;
+	int line = 1;
+	while(p < end) {
+		const char *eol = LineEnd(p, end);
+		if(TrimRight(p, eol) == p) {
+			p = eol == end ? end : eol+1;
+			line++;
+			continue;
+		}
+
+		Record r;
+		r.name = p;
+		r.name_size = (eol > p && eol[-1] == '\r' ? eol-1 : eol)-p;
+		r.line = line;
+
+		//Number of points.
+		if(eol == end) {
+			error->line = line+1;
+			error->column = 1;
+			error->message = "unexpected end of file, expected the number of points";
+			return false;
+		}
+		const char *count = eol+1;
+		eol = LineEnd(count, end);
+		const char *q = count;
+		while(q < eol && IsSpace(*q))
+			q++;
+		long long n = 0;
+		const char *digits = q;
+		for(; q < eol && IsDigit(*q); q++) {
+			n = n < 1000000000 ? n*10 + (*q-'0') : n;
+		}
+		const char *bad = q;
+		while(q < eol && IsSpace(*q))
+			q++;
+		if(bad == digits || q != eol || n > 0x7fffffff) {
+			error->line = line+1;
+			error->column = (int)((bad == digits ? digits : bad)-count)+1;
+			error->message = "expected the number of points";
+			return false;
+		}
+		r.count = (int)n;
+
+		//Points.
+		if(eol == end) {
+			error->line = line+2;
+			error->column = 1;
+			error->message = "unexpected end of file, expected the points";
+			return false;
+		}
+		r.points = eol+1;
+		r.points_end = LineEnd(r.points, end);
+		records->push_back(r);
+		p = r.points_end == end ? end : r.points_end+1;
+		line += 3;
+	}
+
+	return true;
+}
+
+bool GestureParser::Parse(const char *data, size_t size, WorkerPool *pool, Gestures *result, Error *error,
+		float tolerance, int *simplified) {
+	//First pass, find the lines of each gesture. On error the records before it are still checked below, as their
+	//errors come first in the file.
+	std::vector<Record> records;
+	Error first_pass;
+	Scan(data, size, &records, &first_pass);
+
+	//Second pass, the points. Gestures are created up front, so that a failure anywhere deletes them in one place.
+	std::vector<Gesture *> gestures(records.size());
+	for(int i=0; i<records.size(); i++) {
+		gestures[i] = new Gesture;
+	}
+	ParseTask task(records, gestures, tolerance);
+	if(pool)
+		pool->Run(&task, records.size(), kChunkSize);
+	else
+		task.Run(0, 0, records.size());
+
+	*error = first_pass;
+	const std::vector<Failure> &failures = task.GetFailures();
+	for(int i=0; i<records.size(); i++) {
+		if(failures[i].error_at) {
+			SetError(records[i], failures[i], error);
+			break;
+		}
+	}
+	if(error->line != 0) {
+		for(int i=0; i<gestures.size(); i++) {
+			delete gestures[i];
+		}
+		return false;
+	}
+
+	for(int i=0; i<records.size(); i++) {
+		result->push_back(std::make_pair(std::string(records[i].name, records[i].name_size), gestures[i]));
+	}
+	if(simplified)
+		*simplified = task.Simplified();
+	return true;
+}
@@ -0,0 +1,74 @@
+#ifndef GESTURE_PARSER_H_
+#define GESTURE_PARSER_H_
+
+#include <string>
+#include <vector>
+#include <utility>
+
+#include <stddef.h>
+
+class Gesture;
+class WorkerPool;
+
+/**
+ * Parser of the text gesture format, three lines per gesture:
+ *		name
+ *		number of points
+ *		x y x y ... separated by spaces or tabs
+ * Blank lines between gestures are skipped, line ends may be "\n" or "\r\n".
+ *
+ * The whole text is parsed in place without building a string per token. A first pass only finds the lines of each
+ * gesture, which is a plain scan for line ends. The coordinates, which are nearly all of the text, are then parsed
+ * gesture by gesture spread over a WorkerPool, and each gesture gets its Descriptor built on the way.
+ */
+class GestureParser {
+public:
+	typedef std::vector<std::pair<std::string, Gesture *> > Gestures;
+
+	struct Error {
+		int line;			//Starting from 1, so are columns.
+		int column;
+		std::string message;
+
+		Error() : line(0), column(0) {}
+	};
+
+	//Where a gesture is in the text.
+	struct Record {
+		const char *name;
+		int name_size;
+		int line;						//Line of the name, the points are two lines down.
+		int count;
+		const char *points, *points_end;
+	};
+
+	/**
+	 * Parse data[0, size) and append the gestures to result, which the caller owns.
+	 * Return false on the first error in file order and fill error, nothing is appended then.
+	 * pool spreads the gestures over threads, it may be 0.
+	 * A positive tolerance simplifies the points of each gesture before building it (@see simplify::Rdp), simplified
+	 * then gets how many points went.
+	 */
+	static bool Parse(const char *data, size_t size, WorkerPool *pool, Gestures *result, Error *error,
+			float tolerance = 0.0f, int *simplified = 0);
+
+	/**
+	 * First pass of Parse alone, find the records in data[0, size) without parsing any point, which is a lot faster.
+	 * Return false on the first error, records then holds the ones before it.
+	 */
+	static bool Scan(const char *data, size_t size, std::vector<Record> *records, Error *error);
+	//Parse the points of record into g, which must be empty, and build its Descriptor. Return how many points a
+	//positive tolerance simplified away in simplified.
+	static bool ParseRecord(const Record &record, Gesture *g, Error *error, float tolerance = 0.0f, int *simplified = 0);
+
+	/**
+	 * Parse a number from [begin, end), which must be all of it. Return false if it is not a number.
+	 * The result is the same as (float)strtod, but common numbers take a fast path without strtod.
+	 */
+	static bool ParseFloat(const char *begin, const char *end, float *value);
+
+private:
+	class ParseTask;
+};
+
+#endif			//GESTURE_PARSER_H_
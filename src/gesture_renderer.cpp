@@ -0,0 +1,122 @@
+#include "gesture_renderer.h"
+#include "timeline.h"
+
+#include <assert.h>
+
+GestureRenderer::GestureRenderer() : gesture(0), revision(0), renderer(0) {
+	pens.push_back(PenConfig(0.0f, wxPen(wxColor(0, 0, 0), 1)));
+}
+
+void GestureRenderer::ClearPens() {
+	pens.erase(pens.begin()+1, pens.end());
+}
+
+void GestureRenderer::SetPen(float start, const wxPen& pen) {
+	//Just do linear search here.
+	if(start == 0.0f) {
+		pens[0].pen = pen;
+		return;
+	}
+
+	assert(start>0.0f && start<1.0f);
+	for(int i=0; i<pens.size(); i++) {
+		if(pens[i].p  > start) {
+			pens.insert(pens.begin()+i, PenConfig(start, pen));
+			return;
+		}
+	}
+	pens.push_back(PenConfig(start, pen));
+}
+
+void GestureRenderer::SetPens(int count, const float *starts, const wxPen *const *_pens) {
+	assert(count > 0 && starts[0] == 0.0f);
+	pens.resize(count);
+	for(int i=0; i<count; i++) {
+		assert(i == 0 || starts[i] >= starts[i-1]);
+		pens[i].p = starts[i];
+		if(!pens[i].pen.IsSameAs(*_pens[i]))
+			pens[i].pen = *_pens[i];
+	}
+}
+
+void GestureRenderer::Reserve(int pen_count) {
+	pens.reserve(pen_count);
+	indices.reserve(pen_count+1);
+	paths.reserve(pen_count);
+	split.reserve(pen_count+1);
+}
+
+void GestureRenderer::Render(wxGraphicsContext *gc, const Gesture &g) {
+	TimelineSpan span("GestureRenderer::Render");
+	if(g.Size() == 0)
+		return;
+
+	BuildPaths(gc, g);
+	gc->PushState();
+	gc->Translate(transform.x, transform.y);
+	for(int i=0; i<pens.size(); i++) {
+		if(pens[i].pen.GetWidth() == 0)
+			continue;
+		gc->SetPen(pens[i].pen);
+		gc->StrokePath(paths[i]);
+	}
+	gc->PopState();
+}
+
+void GestureRenderer::RenderTail(wxGraphicsContext *gc, const Gesture &g, int first) const {
+	first = first < 0 ? 0 : first;
+	if(first >= g.Size()-1 || pens.back().pen.GetWidth() == 0)
+		return;
+
+	wxGraphicsPath path = gc->CreatePath();
+	Gesture::Point p = g.Get(first);
+	path.MoveToPoint(p.x+transform.x, p.y+transform.y);
+	for(int i=first+1; i<g.Size(); i++) {
+		p = g.Get(i);
+		path.AddLineToPoint(p.x+transform.x, p.y+transform.y);
+	}
+	gc->SetPen(pens.back().pen);
+	gc->StrokePath(path);
+}
+
+void GestureRenderer::BuildPaths(wxGraphicsContext *gc, const Gesture &g) {
+	//Pen k draws segments split[k] to split[k+1]-1. Assume the interval of piecewise function is small.
+	int last = g.Size()-1;
+	float length = g.Length();
+	split.clear();
+	split.push_back(0);
+	for(int i=0; i<last && split.size()<pens.size(); i++) {
+		if(g.LengthAt(i+1) > pens[split.size()].p*length)
+			split.push_back(i);
+	}
+	//Pens starting at the very end have nothing to draw.
+	while(split.size() <= pens.size()) {
+		split.push_back(last);
+	}
+
+	//Only the points of a pen matter, its color and width are picked when stroking.
+	bool same = gesture == &g && revision == g.Revision() && renderer == gc->GetRenderer();
+	if(same && split == indices)
+		return;
+	paths.resize(pens.size());
+	for(int k=0; k<pens.size(); k++) {
+		if(same && k+1 < indices.size() && indices[k] == split[k] && indices[k+1] == split[k+1])
+			continue;
+		//One polyline per pen, rather than a separate line per segment.
+		wxGraphicsPath path = gc->CreatePath();
+		int begin = split[k], end = split[k+1];
+		if(end > begin) {
+			Gesture::Point p = g.Get(begin);
+			path.MoveToPoint(p.x, p.y);
+			for(int j=begin+1; j<=end; j++) {
+				p = g.Get(j);
+				path.AddLineToPoint(p.x, p.y);
+			}
+		}
+		paths[k] = path;
+	}
+	indices.swap(split);
+	gesture = &g;
+	revision = g.Revision();
+	renderer = gc->GetRenderer();
+}
@@ -0,0 +1,74 @@
+#ifndef GESTURE_RENDERER_H_
+#define GESTURE_RENDERER_H_
+
+#include "gesture.h"
+
+#include <vector>
+
+#include <wx/pen.h>
+#include <wx/graphics.h>
+
+/**
+ * Draws a Gesture with wxWidgets. Gesture is geometry only and shared read only by the recognizer, so how it looks
+ * is kept here: the pens along its arc length and where it goes on screen. Templates thereby carry no GUI objects,
+ * and the same template can be drawn by several renderers at once.
+ *
+ * The polyline of each pen is built once and kept until the gesture changes (@see Gesture::Revision()), another one
+ * is drawn or the points the pen covers change, so repainting an unchanged gesture only strokes paths and a pen start
+ * moving within a segment costs nothing. UI thread only.
+ */
+class GestureRenderer {
+public:
+	//Pen used from arc length parameter p on.
+	struct PenConfig {
+		float p;
+		wxPen pen;
+
+		PenConfig() {}
+		PenConfig(float _p, const wxPen &_pen) : p(_p), pen(_pen) {}
+	};
+	typedef std::vector<PenConfig> Pens;
+
+public:
+	//One black pen of width 1, at no offset.
+	GestureRenderer();
+
+	//Back to the first pen alone.
+	void ClearPens();
+	void SetPen(float start, const wxPen &pen);
+	/**
+	 * All pens at once, count of them sorted by start, the first one starting at 0.0f. A pen already in place is not
+	 * assigned again, so the same pens set over and over only move where they start.
+	 */
+	void SetPens(int count, const float *starts, const wxPen *const *pens);
+	const Pens &GetPens() const { return pens; }
+	//Room for pen_count pens and their paths, so that SetPens with as many does not allocate.
+	void Reserve(int pen_count);
+
+	//Added to the points, which are relative to the anchor of the gesture.
+	GestureRenderer &SetTransform(float x, float y) { transform.x = x; transform.y = y; return *this; }
+	Gesture::Point GetTransform() const { return transform; }
+
+	//Draw g on gc, which the caller shares between every gesture of a paint.
+	void Render(wxGraphicsContext *gc, const Gesture &g);
+	//Only the segments of g from point first on, with the last pen, e.g. what a stroke being drawn has just grown by.
+	void RenderTail(wxGraphicsContext *gc, const Gesture &g, int first) const;
+
+private:
+	//Split g for the pens and build a path of each part on gc, unless it is there already.
+	void BuildPaths(wxGraphicsContext *gc, const Gesture &g);
+
+private:
+	Pens pens;
+	Gesture::Point transform;
+
+	//Paths of the last Render.
+	const Gesture *gesture;
+	long revision;							//Of gesture.
+	wxGraphicsRenderer *renderer;			//Paths only work with contexts of the renderer they come from.
+	std::vector<int> indices;				//First point of each pen, followed by the last point.
+	std::vector<wxGraphicsPath> paths;		//Polyline of each pen, relative to anchor.
+	std::vector<int> split;					//Scratch of BuildPaths, indices for the pens now.
+};
+
+#endif			//GESTURE_RENDERER_H_
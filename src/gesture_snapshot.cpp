@@ -0,0 +1,55 @@
+#include "gesture_snapshot.h"
+#include "gesture.h"
+#include "gesture_library.h"
+#include "gesture_store.h"
+
+#include <assert.h>
+
+#ifdef _MSC_VER
+	#include <intrin.h>
+	#define ATOMIC_INCREMENT(p) _InterlockedIncrement(p)
+	#define ATOMIC_DECREMENT(p) _InterlockedDecrement(p)
+#else
+	#define ATOMIC_INCREMENT(p) __sync_add_and_fetch(p, 1)
+	#define ATOMIC_DECREMENT(p) __sync_sub_and_fetch(p, 1)
+#endif
+
+GestureSnapshot::GestureSnapshot(const GestureIndex &_index) : index(_index), next(0), references(1) {
+	templates.reserve(index.LiveSize());
+	for(int i=0; i<index.Size(); i++) {
+		if(!index.IsRemoved(i))
+			templates.push_back(std::make_pair(index.GetName(i), index.Get(i)));
+	}
+}
+
+GestureSnapshot::~GestureSnapshot() {
+	//next is released by Release, so that a long chain does not recurse.
+	for(int i=0; i<gestures.size(); i++) {
+		delete gestures[i];
+	}
+	for(int i=0; i<stores.size(); i++) {
+		delete stores[i];
+	}
+	for(int i=0; i<libraries.size(); i++) {
+		delete libraries[i];
+	}
+}
+
+void GestureSnapshot::AddRef() const {
+	ATOMIC_INCREMENT(&references);
+}
+
+void GestureSnapshot::Release() const {
+	const GestureSnapshot *s = this;
+	while(s && ATOMIC_DECREMENT(&s->references) == 0) {
+		const GestureSnapshot *next = s->next;
+		delete s;
+		s = next;
+	}
+}
+
+void GestureSnapshot::SetNext(const GestureSnapshot *_next) {
+	assert(!next);
+	_next->AddRef();
+	next = _next;
+}
@@ -0,0 +1,70 @@
+#ifndef GESTURE_SNAPSHOT_H_
+#define GESTURE_SNAPSHOT_H_
+
+#include "gesture_index.h"
+
+#include <string>
+#include <vector>
+#include <utility>
+
+class Gesture;
+class GestureLibrary;
+class GestureStore;
+
+/**
+ * The templates of a GestureManager as they were at one point, and the index over them. Nothing in it changes once it
+ * is made, so any number of strokes, stages and threads read one snapshot at the same time without locking, and
+ * share it by pointer rather than copying the template list per stroke. What is shown for a stroke, its candidates,
+ * pens and placement, lives with the stroke instead, @see FeedForward and Feedback.
+ *
+ * A snapshot is reference counted. The manager publishes a new one whenever its templates change, and the store,
+ * libraries and gestures it no longer needs are only freed once no snapshot made before can reach them. So a stroke
+ * holding a snapshot keeps matching against it while another file is loaded, and even after the manager is gone.
+ *
+ * GetTemplates() are the templates of GetIndex() not removed, in order of id, so BestMatch over either picks the same
+ * one. Ids skip the templates a GestureManager::Put replaced since the last load, use GetName() rather than position.
+ */
+class GestureSnapshot {
+public:
+	typedef std::vector<std::pair<std::string, const Gesture *> > Templates;
+
+public:
+	const Templates &GetTemplates() const { return templates; }
+	const GestureIndex &GetIndex() const { return index; }
+	int Size() const { return templates.size(); }
+
+	//Thread safe. The snapshot is deleted with its last reference.
+	void AddRef() const;
+	void Release() const;
+
+private:
+	friend class GestureManager;
+
+	//A copy of index, with one reference for the caller.
+	explicit GestureSnapshot(const GestureIndex &index);
+	~GestureSnapshot();
+	GestureSnapshot(const GestureSnapshot &);
+	void operator=(const GestureSnapshot &);
+
+	/**
+	 * next is made after this one and kept alive by it. What the manager stops using is retired into its latest
+	 * snapshot, which every older snapshot reaches this way, so it is freed only after each one that may see it.
+	 */
+	void SetNext(const GestureSnapshot *next);
+	//Free with the snapshot, @see SetNext().
+	void Retire(GestureStore *store) { stores.push_back(store); }
+	void Retire(GestureLibrary *library) { libraries.push_back(library); }
+	void Retire(Gesture *g) { gestures.push_back(g); }
+
+private:
+	Templates templates;
+	GestureIndex index;
+	const GestureSnapshot *next;
+	mutable volatile long references;
+
+	std::vector<GestureStore *> stores;
+	std::vector<GestureLibrary *> libraries;
+	std::vector<Gesture *> gestures;
+};
+
+#endif			//GESTURE_SNAPSHOT_H_
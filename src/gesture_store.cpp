@@ -0,0 +1,134 @@
+#include "gesture_store.h"
+#include "gesture_library.h"
+
+#include <string.h>
+
+GestureStore::GestureStore() : used(0), live(0) {
+
+}
+
+void GestureStore::Reserve(int count, int points) {
+	arena.resize((size_t)points*3);
+	gestures.resize(count);
+	descriptors.resize(count);
+	entries.reserve(count);
+}
+
+void GestureStore::AddName(const std::string &name) {
+	Entry e;
+	e.name_offset = names.size();
+	e.name_size = name.size();
+	e.hash = Hash(name.data(), name.size());
+	e.removed = false;
+	e.library = 0;
+	e.library_entry = -1;
+	names.insert(names.end(), name.begin(), name.end());
+	entries.push_back(e);
+	live++;
+}
+
+void GestureStore::Add(const std::string &name, const Gesture &g) {
+	int i = entries.size();
+	AddName(name);
+
+	int n = g.Size();
+	float *xs = arena.empty() ? 0 : &arena[0]+used, *ys = xs+n, *lengths = ys+n;
+	used += n*3;
+	Gesture::Point box_min = n > 0 ? g.Get(0) : Gesture::Point(), box_max = box_min;
+	for(int j=0; j<n; j++) {
+		Gesture::Point p = g.Get(j);
+		xs[j] = p.x;
+		ys[j] = p.y;
+		lengths[j] = g.LengthAt(j);
+		box_min.x = p.x < box_min.x ? p.x : box_min.x;
+		box_min.y = p.y < box_min.y ? p.y : box_min.y;
+		box_max.x = p.x > box_max.x ? p.x : box_max.x;
+		box_max.y = p.y > box_max.y ? p.y : box_max.y;
+	}
+	gestures[i].View(xs, ys, lengths, n, g.GetAnchor(), box_min, box_max);
+	if(g.GetDescriptor()) {
+		descriptors[i] = *g.GetDescriptor();
+		gestures[i].SetDescriptor(&descriptors[i]);
+	}
+}
+
+void GestureStore::Add(const std::string &name, const GestureLibrary *library, int entry) {
+	int i = entries.size();
+	AddName(name);
+	entries[i].library = library;
+	entries[i].library_entry = entry;
+	library->View(entry, &gestures[i]);
+}
+
+void GestureStore::Add(const GestureStore &other, int i) {
+	const Entry &e = other.entries[i];
+	if(e.library)
+		Add(other.GetName(i), e.library, e.library_entry);
+	else
+		Add(other.GetName(i), other.gestures[i]);
+}
+
+void GestureStore::Finish() {
+	for(int i=0; i<entries.size(); i++) {
+		if(!gestures[i].GetDescriptor())
+			gestures[i].BuildDescriptor(&descriptors[i]);
+	}
+
+	//At most half full, so that probes stay short.
+	int size = 16;
+	while(size < entries.size()*2)
+		size *= 2;
+	slots.assign(size, -1);
+	for(int i=0; i<entries.size(); i++) {
+		const Entry &e = entries[i];
+		const char *name = names.empty() ? 0 : &names[e.name_offset];
+		int s = e.hash & (size-1);
+		for(; slots[s] != -1; s = (s+1) & (size-1)) {
+			if(NameIs(slots[s], name, e.name_size, e.hash)) {
+				Remove(slots[s]);
+				break;
+			}
+		}
+		slots[s] = i;
+	}
+}
+
+int GestureStore::Find(const std::string &name) const {
+	if(slots.empty())
+		return -1;
+	uint32_t hash = Hash(name.data(), name.size());
+	int mask = slots.size()-1;
+	for(int s = hash & mask; slots[s] != -1; s = (s+1) & mask) {
+		int i = slots[s];
+		if(NameIs(i, name.data(), name.size(), hash))
+			return entries[i].removed ? -1 : i;
+	}
+	return -1;
+}
+
+void GestureStore::Remove(int i) {
+	//The slot keeps pointing at it, names are unique in the hash so it stays a dead end for that name alone.
+	if(!entries[i].removed) {
+		entries[i].removed = true;
+		live--;
+	}
+}
+
+std::string GestureStore::GetName(int i) const {
+	const Entry &e = entries[i];
+	return e.name_size == 0 ? std::string() : std::string(&names[e.name_offset], e.name_size);
+}
+
+bool GestureStore::NameIs(int i, const char *s, int n, uint32_t hash) const {
+	const Entry &e = entries[i];
+	return e.hash == hash && e.name_size == n && (n == 0 || memcmp(&names[e.name_offset], s, n) == 0);
+}
+
+//FNV-1a.
+uint32_t GestureStore::Hash(const char *s, int n) {
+	uint32_t h = 2166136261u;
+	for(int i=0; i<n; i++) {
+		h = (h ^ (unsigned char)s[i]) * 16777619u;
+	}
+	return h;
+}
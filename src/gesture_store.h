@@ -0,0 +1,88 @@
+#ifndef GESTURE_STORE_H_
+#define GESTURE_STORE_H_
+
+#include "gesture.h"
+
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+class GestureLibrary;
+
+/**
+ * Flat storage of template gestures. Everything lives in a handful of arrays sized once by Reserve():
+ *		points of every gesture in one arena, [xs | ys | lengths] per gesture, which the gestures view
+ *		the gestures themselves and their Descriptors, one after another
+ *		names in one buffer, found through an open addressing hash
+ * So iterating the templates walks memory linearly, and tearing the store down frees a few blocks instead of a heap
+ * object per gesture and per array. Gestures of a GestureLibrary are views into the mapping and take no arena.
+ *
+ * Gestures are identified by their position, which stays the same until the store is destroyed.
+ * Gestures are geometry only, so nothing else is allocated per gesture.
+ */
+class GestureStore {
+private:
+	struct Entry {
+		uint32_t name_offset;		//Into names.
+		uint32_t name_size;
+		uint32_t hash;
+		bool removed;
+		const GestureLibrary *library;		//If a view of library_entry of it, 0 otherwise.
+		int library_entry;
+	};
+
+public:
+	GestureStore();
+
+	/**
+	 * Make room for count gestures with points copied in total, views of a library not included.
+	 * Call it once before any Add, which must not go beyond it.
+	 */
+	void Reserve(int count, int points);
+	//Copy g into the arena, together with its Descriptor if it has one.
+	void Add(const std::string &name, const Gesture &g);
+	//View entry of library without copying, library must outlive the store or at least the gesture being removed.
+	void Add(const std::string &name, const GestureLibrary *library, int entry);
+	//Add gesture i of other the same way it was added there.
+	void Add(const GestureStore &other, int i);
+	/**
+	 * Call it once every gesture is added. Build the missing Descriptors and the name hash.
+	 * Of gestures with the same name, the last one added wins and the others are removed.
+	 */
+	void Finish();
+
+	//Return -1 if there is no such gesture or it is removed.
+	int Find(const std::string &name) const;
+	//The gesture won't be found any more, its position is not reused.
+	void Remove(int i);
+	bool IsRemoved(int i) const { return entries[i].removed; }
+	//Whether the points of gesture i are in the arena, @see Reserve().
+	bool IsCopied(int i) const { return entries[i].library == 0; }
+	//The library gesture i is a view of, 0 if copied.
+	const GestureLibrary *GetLibrary(int i) const { return entries[i].library; }
+
+	Gesture *Get(int i) { return &gestures[i]; }
+	const Gesture *Get(int i) const { return &gestures[i]; }
+	std::string GetName(int i) const;
+	//Including removed gestures.
+	int Size() const { return entries.size(); }
+	int LiveSize() const { return live; }
+
+private:
+	static uint32_t Hash(const char *s, int n);
+	bool NameIs(int i, const char *s, int n, uint32_t hash) const;
+	void AddName(const std::string &name);
+
+private:
+	std::vector<float> arena;
+	int used;							//Floats of arena in use.
+	std::vector<Gesture> gestures;		//Sized by Reserve, so that views never move.
+	std::vector<Gesture::Descriptor> descriptors;		//Parallel to gestures.
+	std::vector<Entry> entries;
+	std::vector<char> names;
+	std::vector<int> slots;				//Open addressing by linear probing, -1 for empty. Size is a power of two.
+	int live;
+};
+
+#endif			//GESTURE_STORE_H_
@@ -0,0 +1,106 @@
+#include "mapped_file.h"
+
+#ifdef _WIN32
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+//Data of an empty file, which cannot be mapped.
+static const char kEmpty[1] = {0};
+
+#ifdef _WIN32
+
+MappedFile::MappedFile() : data(0), size(0), file(INVALID_HANDLE_VALUE), mapping(0) {
+
+}
+
+bool MappedFile::Open(const std::string &file_name) {
+	Close();
+	file = CreateFileA(file_name.c_str(), GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, 0);
+	if(file == INVALID_HANDLE_VALUE)
+		return false;
+	LARGE_INTEGER file_size;
+	if(!GetFileSizeEx(file, &file_size) || (unsigned long long)file_size.QuadPart > (size_t)-1) {
+		Close();
+		return false;
+	}
+	if(file_size.QuadPart == 0) {
+		data = kEmpty;
+		return true;
+	}
+	mapping = CreateFileMappingA(file, 0, PAGE_READONLY, 0, 0, 0);
+	if(!mapping) {
+		Close();
+		return false;
+	}
+	data = (const char *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if(!data) {
+		Close();
+		return false;
+	}
+	size = (size_t)file_size.QuadPart;
+	return true;
+}
+
+void MappedFile::Close() {
+	if(data && data != kEmpty)
+		UnmapViewOfFile(data);
+	if(mapping)
+		CloseHandle(mapping);
+	if(file != INVALID_HANDLE_VALUE)
+		CloseHandle(file);
+	data = 0;
+	size = 0;
+	mapping = 0;
+	file = INVALID_HANDLE_VALUE;
+}
+
+#else
+
+MappedFile::MappedFile() : data(0), size(0), file(-1) {
+
+}
+
+bool MappedFile::Open(const std::string &file_name) {
+	Close();
+	file = open(file_name.c_str(), O_RDONLY);
+	if(file == -1)
+		return false;
+	struct stat st;
+	if(fstat(file, &st) != 0) {
+		Close();
+		return false;
+	}
+	if(st.st_size == 0) {
+		data = kEmpty;
+		return true;
+	}
+	void *p = mmap(0, (size_t)st.st_size, PROT_READ, MAP_SHARED, file, 0);
+	if(p == MAP_FAILED) {
+		Close();
+		return false;
+	}
+	data = (const char *)p;
+	size = (size_t)st.st_size;
+	return true;
+}
+
+void MappedFile::Close() {
+	if(data && data != kEmpty)
+		munmap((void *)data, size);
+	if(file != -1)
+		close(file);
+	data = 0;
+	size = 0;
+	file = -1;
+}
+
+#endif
+
+MappedFile::~MappedFile() {
+	Close();
+}
@@ -0,0 +1,41 @@
+#ifndef MAPPED_FILE_H_
+#define MAPPED_FILE_H_
+
+#include <string>
+#include <stddef.h>
+
+/**
+ * A whole file mapped read only into memory, so that its content can be used in place instead of being read and copied.
+ * Pages are loaded by the OS on first touch and shared with every other process mapping the same file.
+ */
+class MappedFile {
+public:
+	MappedFile();
+	~MappedFile();
+
+	//Return false if the file cannot be opened or mapped. An empty file gives an empty range, nothing is mapped.
+	bool Open(const std::string &file_name);
+	void Close();
+
+	bool IsOpen() const { return data != 0; }
+	//Valid until Close.
+	const char *Data() const { return data; }
+	size_t Size() const { return size; }
+
+private:
+	//Not copyable.
+	MappedFile(const MappedFile &);
+	void operator=(const MappedFile &);
+
+private:
+	const char *data;
+	size_t size;
+#ifdef _WIN32
+	void *file;			//HANDLE, not pulling windows.h in here.
+	void *mapping;
+#else
+	int file;
+#endif
+};
+
+#endif			//MAPPED_FILE_H_
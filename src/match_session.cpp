@@ -0,0 +1,169 @@
+#include "match_session.h"
+#include "gesture.h"
+#include "worker_pool.h"
+
+#include <math.h>
+#include <assert.h>
+#include <limits>
+
+MatchSession::MatchSession() : query(0), seen_size(0), pool(0), 
+			max_error(std::numeric_limits<float>::infinity()), max_length_ratio(std::numeric_limits<float>::infinity()), 
+			length_pruned(0), abandoned(0) {
+
+}
+
+void MatchSession::SetLimits(float error, float length_ratio) {
+	max_error = error;
+	max_length_ratio = length_ratio;
+}
+
+void MatchSession::Begin(const Gesture *q, const std::vector<std::pair<std::string, const Gesture *> > &templates) {
+	query = q;
+	seen_size = 0;
+	length_pruned = abandoned = 0;
+	candidates.clear();
+	candidates.reserve(templates.size());
+	active.clear();
+	active.reserve(templates.size());
+	for(int i=0; i<templates.size(); i++) {
+		candidates.push_back(Candidate(templates[i].second));
+		active.push_back(i);
+	}
+	Update();
+}
+
+//Advances a chunk of active candidates.
+class MatchSession::AdvanceTask : public WorkerPool::Task {
+public:
+	AdvanceTask(MatchSession *_session) : session(_session) {}
+
+	virtual void Run(int chunk, int begin, int end) {
+		for(int a=begin; a<end; a++) {
+			session->Advance(session->candidates[session->active[a]]);
+		}
+	}
+
+private:
+	MatchSession *session;
+};
+
+void MatchSession::Update() {
+	if(!query)
+		return;
+	int n = query->Size();
+	//Points are only ever appended, anything else means a different stroke.
+	if(n < seen_size)
+		Restart();
+	seen_size = n;
+	if(n <= 1)
+		return;
+
+	//Candidates are independent of each other, so they can be advanced in any order.
+	AdvanceTask task(this);
+	if(pool)
+		pool->Run(&task, active.size(), kChunkSize);
+	else
+		task.Run(0, 0, active.size());
+
+	//Pruned candidates are dropped from active, so they cost nothing on later updates.
+	int kept = 0;
+	for(int a=0; a<active.size(); a++) {
+		int i = active[a];
+		if(candidates[i].state == LENGTH_PRUNED)
+			length_pruned++;
+		else if(candidates[i].state == ABANDONED)
+			abandoned++;
+		else
+			active[kept++] = i;
+	}
+	active.resize(kept);
+}
+
+void MatchSession::Advance(Candidate &c) const {
+	int n = query->Size();
+	float length = query->Length();
+	if(length > c.gesture->Length()*max_length_ratio) {
+		c.state = LENGTH_PRUNED;
+		return;
+	}
+	const Gesture::Descriptor *d = c.gesture->GetDescriptor();
+	if(!d)
+		return;
+
+	//Samples on the last segment are taken again, simplification may have moved its end since.
+	c.next = c.settled_next;
+	c.error = c.settled_error;
+	float settled_length = query->LengthAt(n-2);
+	int m = (int)(length/d->length*Gesture::kMaxSampleSize);
+	m = m > Gesture::kMaxSampleSize ? Gesture::kMaxSampleSize : m;
+	//Sample exactly like Gesture::SampleLengths does, resuming the walk where it stopped.
+	for(; c.next<=m; c.next++) {
+		float target = d->lengths[c.next];
+		int k;
+		float w;
+		if(target >= length) {
+			k = n-2;
+			w = 1.0f;
+		}
+		else {
+			while(query->LengthAt(c.cursor+1) < target) {
+				c.cursor++;
+			}
+			k = c.cursor;
+			float left_l = query->LengthAt(k), right_l = query->LengthAt(k+1);
+			w = (target-left_l)/(right_l-left_l);
+		}
+		Gesture::Point left = query->Get(k), right = query->Get(k+1);
+		float x = left.x*(1-w) + right.x*w;
+		float y = left.y*(1-w) + right.y*w;
+		float dx = d->xs[c.next]-x, dy = d->ys[c.next]-y;
+		float e = dx*dx + dy*dy;
+		if(e > Gesture::kErrorClamp)
+			c.error += e;
+		if(target <= settled_length && target < length) {
+			c.settled_next = c.next+1;
+			c.settled_error = c.error;
+		}
+	}
+	//The error average never takes more than kSize samples. Only settled samples count, the others may still get
+	//smaller once the last point moves, while every later sum includes the settled ones.
+	if(c.settled_error > max_error*max_error*Gesture::Descriptor::kSize)
+		c.state = ABANDONED;
+}
+
+float MatchSession::Error(int index) const {
+	const Candidate &c = candidates[index];
+	if(c.state != ACTIVE)
+		return std::numeric_limits<float>::infinity();
+	if(!query || query->Size() <= 1 || c.gesture->Size() <= 1)
+		return 0.0f;
+	//Shorter than one sample interval, Compare only looks at the end points which is O(1) anyway.
+	if(c.next < 2 || !c.gesture->GetDescriptor())
+		return query->Compare(*c.gesture);
+	return sqrt(c.error/c.next);
+}
+
+bool MatchSession::Pruned(int index) const {
+	return candidates[index].state != ACTIVE;
+}
+
+int MatchSession::Size() const {
+	return candidates.size();
+}
+
+void MatchSession::Clear() {
+	query = 0;
+	seen_size = 0;
+	length_pruned = abandoned = 0;
+	candidates.clear();
+	active.clear();
+}
+
+void MatchSession::Restart() {
+	length_pruned = abandoned = 0;
+	active.clear();
+	for(int i=0; i<candidates.size(); i++) {
+		candidates[i] = Candidate(candidates[i].gesture);
+		active.push_back(i);
+	}
+}
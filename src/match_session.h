@@ -0,0 +1,102 @@
+#ifndef MATCH_SESSION_H_
+#define MATCH_SESSION_H_
+
+#include <string>
+#include <vector>
+#include <utility>
+
+class Gesture;
+class WorkerPool;
+
+/**
+ * Incremental version of Gesture::Compare for a stroke that is still being drawn.
+ *
+ * Compare against a template Descriptor samples the query at the template's own sample lengths, and those lengths
+ * never move as the query grows. So each candidate only needs to remember how many samples it has consumed, where
+ * its walk along the query stopped and the running clamped error. A new point costs amortized O(1) per candidate.
+ *
+ * The last point may still move, as strokes are simplified online (@see Gesture::Simplify), so each candidate also
+ * remembers where it stood after the samples that do not depend on it, and takes the few after them again on the
+ * next update.
+ *
+ * Error(i) matches query->Compare(*template) on the current query, up to float summation order when the
+ * vectorized error kernel is in use (@see gesture_kernels.h).
+ *
+ * Candidates that can no longer match for the rest of the stroke are pruned and skipped by later updates,
+ * @see SetLimits().
+ */
+class MatchSession {
+private:
+	enum State {ACTIVE, LENGTH_PRUNED, ABANDONED};
+
+	struct Candidate {
+		const Gesture *gesture;
+		State state;
+		int next;			//Next descriptor sample to consume.
+		int cursor;			//Query segment where the last sample landed.
+		float error;		//Clamped squared error of samples [0, next).
+		int settled_next;	//Samples [0, settled_next) do not depend on the last point.
+		float settled_error;
+
+		Candidate(const Gesture *g) : gesture(g), state(ACTIVE), next(0), cursor(0), error(0.0f),
+				settled_next(0), settled_error(0.0f) {}
+	};
+
+	typedef std::vector<Candidate> Candidates;
+	class AdvanceTask;
+
+	enum {kChunkSize = 256};		//Candidates per chunk of work given to the pool.
+
+public:
+	MatchSession();
+
+	/**
+	 * Start matching query against templates, on NEW_GESTURE.
+	 * query is not owned and must stay alive until the next Begin or Clear. Templates are expected to have descriptors.
+	 */
+	void Begin(const Gesture *query, const std::vector<std::pair<std::string, const Gesture *> > &templates);
+
+	//Catch up with the points appended to the query since the last call, on UPDATE_GESTURE.
+	void Update();
+
+	//Same as GetQuery()->Compare(*template index). Pruned candidates report infinity.
+	float Error(int index) const;
+
+	/**
+	 * Prune a candidate once the query is longer than max_length_ratio times the template, or once its running
+	 * error is so large that even a full set of samples could not bring Error() back under max_error.
+	 * Both conditions only get worse as the query grows, so a pruned candidate stays pruned for the whole stroke.
+	 * Default is no pruning.
+	 */
+	void SetLimits(float max_error, float max_length_ratio);
+	bool Pruned(int index) const;
+	//Index of candidates not pruned yet, ascending.
+	const std::vector<int> &Active() const { return active; }
+	//Prune counters of the current stroke.
+	int LengthPruned() const { return length_pruned; }
+	int Abandoned() const { return abandoned; }
+
+	//Spread Update over pool, which is not owned. 0 to run on the calling thread only.
+	void SetPool(WorkerPool *p) { pool = p; }
+
+	const Gesture *GetQuery() const { return query; }
+	int Size() const;
+	void Clear();
+
+private:
+	void Restart();
+	//Consume the samples the query now covers, called for active candidates only.
+	void Advance(Candidate &c) const;
+
+private:
+	const Gesture *query;
+	int seen_size;
+	Candidates candidates;
+	std::vector<int> active;
+	WorkerPool *pool;
+
+	float max_error, max_length_ratio;
+	int length_pruned, abandoned;
+};
+
+#endif			//MATCH_SESSION_H_
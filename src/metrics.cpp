@@ -0,0 +1,170 @@
+#include "metrics.h"
+
+#include <stdio.h>
+
+#ifdef _WIN32
+	#include <windows.h>
+	#include <intrin.h>
+	#define ATOMIC_INCREMENT(p) _InterlockedIncrement(p)
+#else
+	#include <time.h>
+	#define ATOMIC_INCREMENT(p) __sync_fetch_and_add(p, 1)
+#endif
+
+unsigned long long Metrics::Now() {
+#ifdef _WIN32
+	static LARGE_INTEGER frequency = {0};
+	if(!frequency.QuadPart)
+		QueryPerformanceFrequency(&frequency);
+	LARGE_INTEGER counter;
+	QueryPerformanceCounter(&counter);
+	//Split to keep the multiplication from overflowing.
+	unsigned long long seconds = counter.QuadPart/frequency.QuadPart, rest = counter.QuadPart%frequency.QuadPart;
+	return seconds*1000000000ULL + rest*1000000000ULL/frequency.QuadPart;
+#else
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec*1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+#ifdef OCTOPOCUS_METRICS
+
+//Values below 2*kSub have a bucket each, above that every power of two is split into kSub buckets.
+static const int kSubBits = 4;
+static const int kSub = 1 << kSubBits;
+static const int kBuckets = kSub*(64-kSubBits+1);
+
+static volatile long buckets[Metrics::kCount][kBuckets];
+static volatile long counts[Metrics::kCount];
+
+static const char *kNames[Metrics::kCount] = {
+	"new_gesture", "update_gesture", "complete_gesture", "present", "compare", "paint",
+	"compares_per_round", "points_per_stroke", "simplified_per_stroke",
+	"coalesced_per_stroke", "pruned_per_stroke", "candidates"
+};
+
+//Index of the highest bit set, v > 0.
+static int HighestBit(unsigned long long v) {
+	int n = 0;
+	for(int shift=32; shift>0; shift/=2) {
+		if(v >> shift) {
+			v >>= shift;
+			n += shift;
+		}
+	}
+	return n;
+}
+
+static int BucketOf(unsigned long long v) {
+	if(v < 2*kSub)
+		return (int)v;
+	int shift = HighestBit(v)-kSubBits;
+	return kSub*(shift+1) + (int)(v >> shift) - kSub;
+}
+
+//Smallest value of a bucket, and how many values it spans.
+static unsigned long long BucketStart(int bucket) {
+	if(bucket < 2*kSub)
+		return bucket;
+	int shift = bucket/kSub-1;
+	return (unsigned long long)(bucket%kSub + kSub) << shift;
+}
+
+static unsigned long long BucketWidth(int bucket) {
+	return bucket < 2*kSub ? 1 : 1ULL << (bucket/kSub-1);
+}
+
+void Metrics::Record(Id id, unsigned long long value) {
+	ATOMIC_INCREMENT(&buckets[id][BucketOf(value)]);
+	ATOMIC_INCREMENT(&counts[id]);
+}
+
+unsigned long Metrics::Count(Id id) {
+	return (unsigned long)counts[id];
+}
+
+Metrics::Summary Metrics::Summarize(Id id) {
+	//Copy first, so that the percentiles add up even while others record.
+	static const double kPercentiles[] = {50, 90, 99, 99.9};
+	unsigned long copy[kBuckets];
+	unsigned long total = 0;
+	for(int i=0; i<kBuckets; i++) {
+		copy[i] = (unsigned long)buckets[id][i];
+		total += copy[i];
+	}
+
+	Summary s;
+	s.count = total;
+	double *values[] = {&s.p50, &s.p90, &s.p99, &s.p999};
+	for(int k=0; k<4; k++) {
+		*values[k] = 0.0;
+		//Nearest rank, a value stands for the middle of its bucket.
+		unsigned long rank = (unsigned long)(total*kPercentiles[k]/100.0 + 0.5);
+		rank = rank < 1 ? 1 : rank;
+		unsigned long seen = 0;
+		for(int i=0; i<kBuckets && total; i++) {
+			seen += copy[i];
+			if(seen >= rank) {
+				*values[k] = BucketStart(i) + (BucketWidth(i)-1)/2.0;
+				break;
+			}
+		}
+	}
+	s.max = 0.0;
+	for(int i=kBuckets-1; i>=0; i--) {
+		if(copy[i]) {
+			s.max = (double)(BucketStart(i) + BucketWidth(i)-1);
+			break;
+		}
+	}
+	return s;
+}
+
+const char *Metrics::Name(Id id) {
+	return kNames[id];
+}
+
+static std::string FormatTime(double ns) {
+	char buf[32];
+	if(ns < 1e3)
+		sprintf(buf, "%.0fns", ns);
+	else if(ns < 1e6)
+		sprintf(buf, "%.1fus", ns/1e3);
+	else
+		sprintf(buf, "%.1fms", ns/1e6);
+	return buf;
+}
+
+std::string Metrics::Brief() {
+	static const Id kTimes[] = {UPDATE_GESTURE, PRESENT, PAINT, COMPARE};
+	static const char *kLabels[] = {"update", "present", "paint", "compare"};
+	//p50/p99 of the times, medians of the counts.
+	std::string result;
+	for(int i=0; i<sizeof(kTimes)/sizeof(kTimes[0]); i++) {
+		Summary s = Summarize(kTimes[i]);
+		result += std::string(kLabels[i]) + " " + FormatTime(s.p50) + "/" + FormatTime(s.p99) + "  ";
+	}
+	Summary compares = Summarize(COMPARES_PER_ROUND), pruned = Summarize(PRUNED_PER_STROKE);
+	char buf[128];
+	sprintf(buf, "%.0f compares/round  %.0f pruned/stroke", compares.p50, pruned.p50);
+	return result + buf;
+}
+
+bool Metrics::Dump(const std::string &file) {
+	FILE *f = fopen(file.c_str(), "w");
+	if(!f)
+		return false;
+	fprintf(f, "{\n\t\"metrics\": [\n");
+	for(int i=0; i<kCount; i++) {
+		Summary s = Summarize((Id)i);
+		fprintf(f, "\t\t{\"name\": \"%s\", \"unit\": \"%s\", \"count\": %lu, "
+			"\"p50\": %.1f, \"p90\": %.1f, \"p99\": %.1f, \"p999\": %.1f, \"max\": %.1f}%s\n",
+			kNames[i], i < kTimeCount ? "ns" : "", s.count, s.p50, s.p90, s.p99, s.p999, s.max,
+			i+1 < kCount ? "," : "");
+	}
+	fprintf(f, "\t]\n}\n");
+	return fclose(f) == 0;
+}
+
+#endif			//OCTOPOCUS_METRICS
@@ -0,0 +1,85 @@
+#ifndef METRICS_H_
+#define METRICS_H_
+
+#include <string>
+
+/**
+ * Latency histograms and per event counts of the stroke path, from a mouse move to the next paint.
+ *
+ * Define OCTOPOCUS_METRICS to enable them. Every metric is a log linear histogram in the spirit of HdrHistogram: 16
+ * buckets per power of two, so any value is kept within 1/16 of its size, over the full range of 64 bit values.
+ * Recording is a couple of atomic increments into a fixed table, so it never locks nor allocates and may happen on
+ * any thread, the workers of a WorkerPool included. Reading is done while others record, a snapshot may be off by the
+ * few values recorded meanwhile.
+ * Without the define Metrics and ScopedTimer are empty inline functions, so instrumented code costs nothing.
+ */
+class Metrics {
+public:
+	enum Id {
+		//Nanoseconds spent in.
+		NEW_GESTURE,				//MainFrame::OnNewGesture
+		UPDATE_GESTURE,				//MainFrame::OnUpdateGesture
+		COMPLETE_GESTURE,			//MainFrame::OnCompleteGesture
+		PRESENT,					//FeedForward::Present, the feedforward and feedback of a round.
+		COMPARE,					//Gesture::Compare against a gesture or a descriptor.
+		PAINT,						//Canvas::PaintEvent
+		kTimeCount,
+
+		//Counts.
+		COMPARES_PER_ROUND = kTimeCount,		//Gesture::Compare calls of a stage round, updates and completions.
+		POINTS_PER_STROKE,						//Of completed and cancelled strokes.
+		SIMPLIFIED_PER_STROKE,					//Points dropped while drawing them, @see Gesture::Simplify.
+		COALESCED_PER_STROKE,					//Mouse moves without an UPDATE_GESTURE of their own, @see Canvas.
+		PRUNED_PER_STROKE,						//Candidates dropped without a full compare, @see Recognizer::Stats.
+		CANDIDATES,								//On display after a round.
+		kCount
+	};
+
+	//Monotonic nanoseconds, with or without OCTOPOCUS_METRICS.
+	static unsigned long long Now();
+
+	//Percentiles of one metric, in its own unit.
+	struct Summary {
+		unsigned long count;
+		double p50, p90, p99, p999, max;
+	};
+
+#ifdef OCTOPOCUS_METRICS
+public:
+	static void Record(Id id, unsigned long long value);
+	//Values recorded so far.
+	static unsigned long Count(Id id);
+	static Summary Summarize(Id id);
+	static const char *Name(Id id);
+
+	//One line of the most telling numbers, short enough for a status bar.
+	static std::string Brief();
+	//Every metric as JSON, overwriting file. Return false if it can't be written.
+	static bool Dump(const std::string &file);
+
+#else
+public:
+	static void Record(Id id, unsigned long long value) {}
+	static unsigned long Count(Id id) { return 0; }
+	static std::string Brief() { return std::string(); }
+	static bool Dump(const std::string &file) { return true; }
+#endif			//OCTOPOCUS_METRICS
+};
+
+//Record the time from construction to destruction.
+class ScopedTimer {
+#ifdef OCTOPOCUS_METRICS
+public:
+	explicit ScopedTimer(Metrics::Id _id) : id(_id), start(Metrics::Now()) {}
+	~ScopedTimer() { Metrics::Record(id, Metrics::Now()-start); }
+
+private:
+	Metrics::Id id;
+	unsigned long long start;
+#else
+public:
+	explicit ScopedTimer(Metrics::Id id) {}
+#endif			//OCTOPOCUS_METRICS
+};
+
+#endif			//METRICS_H_
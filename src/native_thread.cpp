@@ -0,0 +1,193 @@
+#include "native_thread.h"
+
+#ifdef _WIN32
+	#include <windows.h>
+	#include <process.h>
+#else
+	#include <pthread.h>
+	#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+struct NativeMutex::Impl {
+	CRITICAL_SECTION section;
+};
+
+NativeMutex::NativeMutex() : impl(new Impl) {
+	InitializeCriticalSection(&impl->section);
+}
+
+NativeMutex::~NativeMutex() {
+	DeleteCriticalSection(&impl->section);
+	delete impl;
+}
+
+void NativeMutex::Lock() {
+	EnterCriticalSection(&impl->section);
+}
+
+void NativeMutex::Unlock() {
+	LeaveCriticalSection(&impl->section);
+}
+
+struct NativeCondition::Impl {
+	CONDITION_VARIABLE condition;
+};
+
+NativeCondition::NativeCondition(NativeMutex &_mutex) : impl(new Impl), mutex(_mutex) {
+	InitializeConditionVariable(&impl->condition);
+}
+
+NativeCondition::~NativeCondition() {
+	delete impl;
+}
+
+void NativeCondition::Wait() {
+	SleepConditionVariableCS(&impl->condition, &mutex.impl->section, INFINITE);
+}
+
+void NativeCondition::Signal() {
+	WakeConditionVariable(&impl->condition);
+}
+
+void NativeCondition::Broadcast() {
+	WakeAllConditionVariable(&impl->condition);
+}
+
+struct NativeThread::Impl {
+	HANDLE handle;
+	Entry entry;
+	void *argument;
+};
+
+static unsigned __stdcall ThreadMain(void *impl) {
+	NativeThread::Impl *i = (NativeThread::Impl *)impl;
+	i->entry(i->argument);
+	return 0;
+}
+
+bool NativeThread::Start(Entry entry, void *argument) {
+	Join();
+	impl = new Impl;
+	impl->entry = entry;
+	impl->argument = argument;
+	impl->handle = (HANDLE)_beginthreadex(0, 0, ThreadMain, impl, 0, 0);
+	if(impl->handle == 0) {
+		delete impl;
+		impl = 0;
+		return false;
+	}
+	return true;
+}
+
+void NativeThread::Join() {
+	if(!impl)
+		return;
+	WaitForSingleObject(impl->handle, INFINITE);
+	CloseHandle(impl->handle);
+	delete impl;
+	impl = 0;
+}
+
+int NativeThread::GetCPUCount() {
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return (int)info.dwNumberOfProcessors;
+}
+
+#else
+
+struct NativeMutex::Impl {
+	pthread_mutex_t mutex;
+};
+
+NativeMutex::NativeMutex() : impl(new Impl) {
+	pthread_mutex_init(&impl->mutex, 0);
+}
+
+NativeMutex::~NativeMutex() {
+	pthread_mutex_destroy(&impl->mutex);
+	delete impl;
+}
+
+void NativeMutex::Lock() {
+	pthread_mutex_lock(&impl->mutex);
+}
+
+void NativeMutex::Unlock() {
+	pthread_mutex_unlock(&impl->mutex);
+}
+
+struct NativeCondition::Impl {
+	pthread_cond_t condition;
+};
+
+NativeCondition::NativeCondition(NativeMutex &_mutex) : impl(new Impl), mutex(_mutex) {
+	pthread_cond_init(&impl->condition, 0);
+}
+
+NativeCondition::~NativeCondition() {
+	pthread_cond_destroy(&impl->condition);
+	delete impl;
+}
+
+void NativeCondition::Wait() {
+	pthread_cond_wait(&impl->condition, &mutex.impl->mutex);
+}
+
+void NativeCondition::Signal() {
+	pthread_cond_signal(&impl->condition);
+}
+
+void NativeCondition::Broadcast() {
+	pthread_cond_broadcast(&impl->condition);
+}
+
+struct NativeThread::Impl {
+	pthread_t thread;
+	Entry entry;
+	void *argument;
+};
+
+static void *ThreadMain(void *impl) {
+	NativeThread::Impl *i = (NativeThread::Impl *)impl;
+	i->entry(i->argument);
+	return 0;
+}
+
+bool NativeThread::Start(Entry entry, void *argument) {
+	Join();
+	impl = new Impl;
+	impl->entry = entry;
+	impl->argument = argument;
+	if(pthread_create(&impl->thread, 0, ThreadMain, impl) != 0) {
+		delete impl;
+		impl = 0;
+		return false;
+	}
+	return true;
+}
+
+void NativeThread::Join() {
+	if(!impl)
+		return;
+	pthread_join(impl->thread, 0);
+	delete impl;
+	impl = 0;
+}
+
+int NativeThread::GetCPUCount() {
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+	return count < 1 ? 1 : (int)count;
+}
+
+#endif			//_WIN32
+
+NativeThread::NativeThread() : impl(0) {
+
+}
+
+NativeThread::~NativeThread() {
+	Join();
+}
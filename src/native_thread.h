@@ -0,0 +1,82 @@
+#ifndef NATIVE_THREAD_H_
+#define NATIVE_THREAD_H_
+
+/**
+ * Thin wrappers of the threads of the platform, Win32 or pthreads, for the recognition core which builds without
+ * wxWidgets, @see WorkerPool. Same shape as wxMutex, wxCondition and wxThread, which the UI side keeps using.
+ * None of them can be copied.
+ */
+class NativeMutex {
+public:
+	NativeMutex();
+	~NativeMutex();
+
+	void Lock();
+	void Unlock();
+
+private:
+	friend class NativeCondition;
+	NativeMutex(const NativeMutex &);
+	void operator=(const NativeMutex &);
+
+	struct Impl;
+	Impl *impl;
+};
+
+class NativeMutexLocker {
+public:
+	explicit NativeMutexLocker(NativeMutex &_mutex) : mutex(_mutex) { mutex.Lock(); }
+	~NativeMutexLocker() { mutex.Unlock(); }
+
+private:
+	NativeMutexLocker(const NativeMutexLocker &);
+	void operator=(const NativeMutexLocker &);
+
+	NativeMutex &mutex;
+};
+
+//Waits on mutex, which must be locked by the caller of Wait.
+class NativeCondition {
+public:
+	explicit NativeCondition(NativeMutex &mutex);
+	~NativeCondition();
+
+	void Wait();
+	void Signal();
+	void Broadcast();
+
+private:
+	NativeCondition(const NativeCondition &);
+	void operator=(const NativeCondition &);
+
+	struct Impl;
+	Impl *impl;
+	NativeMutex &mutex;
+};
+
+class NativeThread {
+public:
+	typedef void (*Entry)(void *argument);
+
+	NativeThread();
+	//Joins the thread if it is still running.
+	~NativeThread();
+
+	//Run entry(argument) on a new thread, return false if it cannot be created.
+	bool Start(Entry entry, void *argument);
+	//Wait for the thread to return.
+	void Join();
+
+	static int GetCPUCount();
+
+	//Of the platform, reached by the thread itself.
+	struct Impl;
+
+private:
+	NativeThread(const NativeThread &);
+	void operator=(const NativeThread &);
+
+	Impl *impl;			//0 unless started.
+};
+
+#endif			//NATIVE_THREAD_H_
@@ -1,4 +1,5 @@
 #include "octopocus_demo.h"
+#include "alloc_check.h"
 #include "canvas.h"
 #include "gesture.h"
 
@@ -8,6 +9,9 @@
 #include <wx/filedlg.h>
 #include <wx/wfstream.h>
 
+//Frames per second the canvas paces updates and repaints at, 0 for every mouse move.
+static const int kFrameRate = 60;
+
 bool OctopocusDemo::OnInit()
 {
 	MainFrame *main_frame = new MainFrame( "Octopocus Demo", wxPoint(200, 150), wxSize(800, 600) );
@@ -15,6 +19,7 @@ bool OctopocusDemo::OnInit()
 	wxBoxSizer *sizer = new wxBoxSizer(wxHORIZONTAL);
 
 	Canvas *canvas = new Canvas(main_frame);
+	canvas->SetFrameRate(kFrameRate);
 	canvas->Subscribe(main_frame);
 	sizer->Add(canvas, 1, wxEXPAND);
 
@@ -27,15 +32,37 @@ bool OctopocusDemo::OnInit()
 
 namespace {
 	//Event ID.
-	enum { myID_OPEN };
+	enum { myID_OPEN, myID_SAVE_AS, myID_RECORD, myID_RECOGNITION, myID_METRICS, myID_TIMELINE };
 }
 
+//Threads used for matching, the UI thread included. 0 for one per cpu.
+static const int kWorkerThreads = 0;
+
+#ifdef OCTOPOCUS_METRICS
+static const int kMetricsInterval = 500;			//Milliseconds between refreshes of the summary.
+static const int kMetricsDumpTicks = 20;			//Refreshes between dumps.
+static const char *kMetricsFile = "octopocus_metrics.json";
+#endif
+
 MainFrame::MainFrame(const wxString& title, const wxPoint& pos, const wxSize& size)
-	: wxFrame(NULL, wxID_ANY, title, pos, size)
+	: wxFrame(NULL, wxID_ANY, title, pos, size), pool(kWorkerThreads),
+	stage(this, myID_RECOGNITION, &pool), controller(&stage, &manager), canvas(0)
+#ifdef OCTOPOCUS_METRICS
+	, metrics_timer(this, myID_METRICS), metrics_ticks(0)
+#endif
 {
 	wxMenu *menuFile = new wxMenu;
 	menuFile->Append(myID_OPEN, "&Open...\tCtrl-O",
 		"Load gestures from file system.");
+	menuFile->Append(myID_SAVE_AS, "&Save As...\tCtrl-S",
+		"Save loaded gestures as text or binary library.");
+	menuFile->AppendCheckItem(myID_RECORD, "&Record Trace...",
+		"Record strokes and their results to a trace file, to be replayed later.");
+#ifdef OCTOPOCUS_TIMELINE
+	menuFile->AppendCheckItem(myID_TIMELINE, "Record &Timeline...",
+		"Record what every thread does, to be looked at in a trace event viewer once recording stops.");
+	Timeline::NameThread("ui");
+#endif
 	menuFile->AppendSeparator();
 	menuFile->Append(wxID_EXIT);
 	wxMenu *menuHelp = new wxMenu;
@@ -44,18 +71,37 @@ MainFrame::MainFrame(const wxString& title, const wxPoint& pos, const wxSize& si
 	menuBar->Append( menuFile, "&File" );
 	menuBar->Append( menuHelp, "&Help" );
 	SetMenuBar( menuBar );
+	//Templates are simplified within the same distance as strokes being drawn.
+	manager.SetSimplify(Gesture::kStrokeSimplify.distance);
+#ifdef OCTOPOCUS_METRICS
+	//Messages keep the first field, the summary takes the rest.
+	static const int kWidths[] = {-1, -3};
+	CreateStatusBar(2);
+	SetStatusWidths(2, kWidths);
+	metrics_timer.Start(kMetricsInterval);
+#else
 	CreateStatusBar();
+#endif
 }
 
 
 
 wxBEGIN_EVENT_TABLE(MainFrame, wxFrame)
 	EVT_MENU(myID_OPEN, MainFrame::OnOpen)
+	EVT_MENU(myID_SAVE_AS, MainFrame::OnSaveAs)
+	EVT_MENU(myID_RECORD, MainFrame::OnRecord)
 	EVT_MENU(wxID_EXIT,  MainFrame::OnExit)
 	EVT_MENU(wxID_ABOUT, MainFrame::OnAbout)
 	EVT_CANVAS(CanvasEvent::NEW_GESTURE, MainFrame::OnNewGesture)
 	EVT_CANVAS(CanvasEvent::UPDATE_GESTURE, MainFrame::OnUpdateGesture)
 	EVT_CANVAS(CanvasEvent::COMPLETE_GESTURE, MainFrame::OnCompleteGesture)
+	EVT_THREAD(myID_RECOGNITION, MainFrame::OnRecognition)
+#ifdef OCTOPOCUS_METRICS
+	EVT_TIMER(myID_METRICS, MainFrame::OnMetrics)
+#endif
+#ifdef OCTOPOCUS_TIMELINE
+	EVT_MENU(myID_TIMELINE, MainFrame::OnTimeline)
+#endif
 wxEND_EVENT_TABLE()
 
 void MainFrame::OnExit(wxCommandEvent& event)
@@ -69,85 +115,10 @@ void MainFrame::OnAbout(wxCommandEvent& event)
 		"About Octopocus", wxOK | wxICON_INFORMATION );
 }
 
-//Things that are configurable.
-static const float kFeedForwardLength = 80.0f;
-static const int kInitialWidth = 10;
-static const unsigned char kTransparency =  20;
-static const float kCancelThreshold = 20.0f;
-static const float kErrorThreshod = 50.0f;
-static const float kLengthUpThreshold = 1.2f;
-static const float kLengthLowThreshold = 0.9f;
-
-void MainFrame::FeedForwardAndFeedBack(Gesture *c, Canvas *canvas) {
-	//TODO: Generate colors on the fly.
-	std::vector<wxColor> colors;
-	colors.push_back(*wxBLUE);
-	colors.push_back(*wxCYAN);
-	colors.push_back(*wxGREEN);
-	colors.push_back(*wxYELLOW);
-	colors.push_back(*wxRED);
-	assert(candiates.size()<=5);		//Hard code colors of size 5.
-
-
-	//Setup gestures to be displayed.
-	Gesture::Point anchor = c->GetAnchor();
-	canvas->ClearText();
-	for(int i=0; i<candiates.size(); i++) {
-		Gesture *cur = candiates[i].second;
-		float falloff = CalculateFalloff(c, cur);
-
-		cur->ClearPens();
-		cur->SetPen(0.0f, wxPen(colors[i], 0));
-
-		float ff_start = c->Length()/cur->Length();
-		ff_start = ff_start > 1.0f ? 1.0f : ff_start;
-		if(ff_start != 1.0f) {
-			cur->SetPen(ff_start, wxPen(colors[i], kInitialWidth * falloff));
-		}
-		
-		float ff_end = ff_start + kFeedForwardLength/cur->Length();
-		ff_end = ff_end > 1.0f ? 1.0f : ff_end;
-
-		
-		if(ff_end != 1.0f) {
-			wxColor trans(colors[i].Red(), colors[i].Green(), colors[i].Blue(), kTransparency);
-			wxPen trans_pen(trans, kInitialWidth * falloff);
-			cur->SetPen(ff_end, trans_pen);
-		}
-
-		//Set transform
-		Gesture::Point transform =  c->Back();
-		float p = c->Length()/cur->Length();
-		p = p >1.0f ? 1.0f : p;
-		Gesture::Point temp = cur->Sample(p);
-		transform.x = -temp.x + transform.x + anchor.x;
-		transform.y = -temp.y + transform.y + anchor.y;
-		cur->SetTransform(transform.x, transform.y);
-
-		//Try to draw candiates names.
-		if(falloff == 0.0f)
-			continue;
-		else {
-			Gesture::Point p = cur->Sample(ff_end);
-			canvas->DrawText(candiates[i].first, p.x + transform.x, p.y + transform.y);
-		}
-	}
-}
-
-float MainFrame::CalculateFalloff(Gesture *source, Gesture *target) {
-	if(source->Length() > target->Length()*kLengthUpThreshold)
-		return 0.0f;
-	float error = source->Compare(*target);
-	if(error > kErrorThreshod)
-		return 0.0f;
-	else
-		return 1.0f - error/kErrorThreshod;
-}
-
 void MainFrame::OnOpen(wxCommandEvent& event) {
 	wxFileDialog 
 		dialog(this, _("Open gesture file"), "", "",
-		"gesture files (*.dat)|*.dat", wxFD_OPEN|wxFD_FILE_MUST_EXIST);
+		"gesture files (*.dat;*.gbin)|*.dat;*.gbin", wxFD_OPEN|wxFD_FILE_MUST_EXIST);
 	if (dialog.ShowModal() == wxID_CANCEL)
 		return;     // the user changed idea...
 
@@ -159,83 +130,165 @@ void MainFrame::OnOpen(wxCommandEvent& event) {
 		wxLogError("Cannot open file '%s'.", dialog.GetPath());
 		return;
 	}
-	if(manager.Load(dialog.GetPath().ToStdString())) {
+	//Strokes keep their snapshot of the templates across the load, but the stage shares the pool with the parser.
+	stage.Flush();
+	if(canvas) {
+		canvas->SetFeedback(0);
+	}
+	//The stage is idle after Flush, so the pool is free to parse. The feedback is gone too, and it points into the
+	//snapshot of its stroke.
+	if(manager.Load(dialog.GetPath().ToStdString(), &pool)) {
+		char buf[128];
+		sprintf(buf, "%d gestures loaded, %d points simplified away.", manager.Size(), manager.Simplified());
+		SetStatusText(buf);
+	}
+	else {
+		SetStatusText("Gesture file is invalid, " + manager.GetError() + ".");
+	}
+}
+
+void MainFrame::OnSaveAs(wxCommandEvent& event) {
+	wxFileDialog 
+		dialog(this, _("Save gesture file"), "", "",
+		"gesture files (*.dat)|*.dat|gesture libraries (*.gbin)|*.gbin", wxFD_SAVE|wxFD_OVERWRITE_PROMPT);
+	if (dialog.ShowModal() == wxID_CANCEL)
+		return;
+
+	GestureManager::Format format = dialog.GetFilterIndex() == 1 ? GestureManager::LIBRARY : GestureManager::TEXT;
+	if(manager.Save(dialog.GetPath().ToStdString(), format)) {
 		char buf[128];
-		sprintf(buf, "%d gestures loaded.", manager.Size());
+		sprintf(buf, "%d gestures saved.", manager.Size());
 		SetStatusText(buf);
 	}
 	else {
-		SetStatusText("Gesture file is invalid.");
+		wxLogError("Cannot save file '%s'.", dialog.GetPath());
+	}
+}
+
+void MainFrame::OnRecord(wxCommandEvent& event) {
+	if(!event.IsChecked()) {
+		controller.SetRecorder(0);
+		recorder.Close();
+		SetStatusText("Trace recording stopped.");
+		return;
+	}
+
+	wxFileDialog
+		dialog(this, _("Record trace"), "", "",
+		"stroke traces (*.trace)|*.trace", wxFD_SAVE|wxFD_OVERWRITE_PROMPT);
+	if(dialog.ShowModal() == wxID_CANCEL) {
+		GetMenuBar()->Check(myID_RECORD, false);
+		return;
+	}
+	if(!recorder.Open(dialog.GetPath().ToStdString())) {
+		wxLogError("Cannot write file '%s'.", dialog.GetPath());
+		GetMenuBar()->Check(myID_RECORD, false);
+		return;
 	}
+	controller.SetRecorder(&recorder);
+	SetStatusText("Recording trace to " + dialog.GetPath() + ".");
 }
 
 void MainFrame::OnNewGesture(CanvasEvent& event) {
-	Canvas *canvas = event.GetCanvas();
+	ScopedTimer timer(Metrics::NEW_GESTURE);
+	TimelineSpan span("MainFrame::OnNewGesture");
+	canvas = event.GetCanvas();
 	Gesture *cur_gesture = canvas->GetCurrentGesture();
 	if(!cur_gesture)		//As event are asynchronous, logic procedure sequence is not reliable. So check here.
 		return;
-	
-	std::vector<std::pair<std::string, Gesture *> > entries;
-	candiates.clear();
-	manager.GetAll(&candiates);
 
-	canvas->ClearGesture();
-	for(int i=0; i<candiates.size(); i++) {
-		canvas->DrawGeture(candiates[i].second);
-	}
-	
-	FeedForwardAndFeedBack(cur_gesture, canvas);
-	canvas->Refresh();
+	controller.Begin(cur_gesture);
+	canvas->SetFeedback(0);
 }
 
 void MainFrame::OnUpdateGesture(CanvasEvent& event) {
+	ScopedTimer timer(Metrics::UPDATE_GESTURE);
+	TimelineSpan span("MainFrame::OnUpdateGesture");
 	Canvas *canvas = event.GetCanvas();
 	Gesture *cur_gesture = canvas->GetCurrentGesture();
 	if(!cur_gesture)		//As event are asynchronous, logic procedure sequence is not reliable. So check here.
 		return;
-	FeedForwardAndFeedBack(cur_gesture, canvas);
+	//Feedback shows up once the stage is done with it, @see OnRecognition().
+	controller.Update(cur_gesture);
 }
 
 void MainFrame::OnCompleteGesture(CanvasEvent& event) {
+	ScopedTimer timer(Metrics::COMPLETE_GESTURE);
+	TimelineSpan span("MainFrame::OnCompleteGesture");
 	Canvas *canvas = event.GetCanvas();
 	Gesture *cur_gesture = canvas->GetCurrentGesture();
 	if(!cur_gesture)			//As event are asynchronous, logic procedure sequence is not reliable. So check here.
 		return;
+	//The result of a stroke that is not cancelled comes back in OnRecognition(). The stroke is copied by then.
+	bool completed = controller.Complete(cur_gesture);
 	canvas->ClearCurrentGesture();
 	canvas->ClearGesture();
 	canvas->ClearText();
-
-	//Check whether gesture is valid or get cancelled.
-	Gesture::Point head=cur_gesture->Front();
-	Gesture::Point tail = cur_gesture->Back();
-	if(Gesture::Point::Distance(head, tail) < kCancelThreshold) {
+	canvas->SetFeedback(0);
+	if(!completed)
 		SetStatusText("Gesture Cancelled.");
-	}
-	else {
-		//Check match
-		int best_match=-1;
-		float best_falloff = 0.0f;
-		for(int i=0; i<candiates.size(); i++) {
-			float temp = CalculateFalloff(cur_gesture, candiates[i].second);
-			float length_ratio = cur_gesture->Length() / candiates[i].second->Length();
-
-			if(length_ratio < kLengthLowThreshold || temp == 0.0f) {
-				continue;
-			}
-
-			if(temp > best_falloff) {
-				best_falloff = temp;
-				best_match = i;
-			}
+}
+
+void MainFrame::OnRecognition(wxThreadEvent& event) {
+	TimelineSpan span("MainFrame::OnRecognition");
+	{
+		//Showing feedback stays off the heap but for wx painting, results below are rare enough to allocate.
+		AllocCheck check;
+		const Feedback *feedback = controller.AcquireFeedback();
+		if(canvas && feedback) {
+			canvas->SetFeedback(feedback);
 		}
+	}
 
-		if(best_match == -1) {
+	//Strokes completed in quick succession may come back on one event, the last one ends up on the status bar.
+	RecognitionStage::Result result;
+	while(controller.TakeResult(&result)) {
+		if(result.match == -1) {
 			SetStatusText("Gesture does not match");
 		}
 		else {
 			char buf[128];
-			sprintf(buf, "Match %s", candiates[best_match].first.c_str());
+			sprintf(buf, "Match %s", result.name.c_str());
 			SetStatusText(buf);
 		}
+
+		const Recognizer::Stats &stats = result.stats;
+		wxLogDebug("Recognizer: %d compares, pruned %d by length, %d by box, %d coarse, %d full, %d accepted. "
+			"Stroke pruned %d by length, %d abandoned. Index took %d distances, %d compares.",
+			stats.compares, stats.length_pruned, stats.box_pruned, stats.coarse_pruned, stats.full_pruned, stats.accepted,
+			stats.session_length_pruned, stats.session_abandoned, stats.index_distances, stats.index_compares);
+	}
+}
+
+#ifdef OCTOPOCUS_METRICS
+void MainFrame::OnMetrics(wxTimerEvent& event) {
+	SetStatusText(Metrics::Brief(), 1);
+	if(++metrics_ticks % kMetricsDumpTicks == 0 && !Metrics::Dump(kMetricsFile)) {
+		wxLogDebug("Cannot write %s.", kMetricsFile);
 	}
-}
\ No newline at end of file
+}
+#endif
+
+#ifdef OCTOPOCUS_TIMELINE
+void MainFrame::OnTimeline(wxCommandEvent& event) {
+	if(!event.IsChecked()) {
+		Timeline::Stop();
+		if(Timeline::Export(timeline_file))
+			SetStatusText("Timeline written to " + timeline_file + ".");
+		else
+			wxLogError("Cannot write file '%s'.", timeline_file);
+		return;
+	}
+
+	wxFileDialog
+		dialog(this, _("Record timeline"), "", "",
+		"trace event files (*.json)|*.json", wxFD_SAVE|wxFD_OVERWRITE_PROMPT);
+	if(dialog.ShowModal() == wxID_CANCEL) {
+		GetMenuBar()->Check(myID_TIMELINE, false);
+		return;
+	}
+	timeline_file = dialog.GetPath().ToStdString();
+	Timeline::Start();
+	SetStatusText("Recording timeline, uncheck to write it.");
+}
+#endif
@@ -7,13 +7,15 @@
 #endif
 
 #include "gesture_manager.h"
-
-#include <vector>
-#include <utility>
+#include "metrics.h"
+#include "recognition_stage.h"
+#include "stroke_controller.h"
+#include "stroke_trace.h"
+#include "timeline.h"
+#include "worker_pool.h"
 
 class MainFrame;
 class CanvasEvent;
-class Gesture;
 class Canvas;
 
 class OctopocusDemo: public wxApp
@@ -24,30 +26,45 @@ public:
 
 class MainFrame: public wxFrame
 {
-private:
-	typedef std::vector<std::pair<std::string, Gesture *> > Gestures;
-
 public:
 	MainFrame(const wxString& title, const wxPoint& pos, const wxSize& size);
 	GestureManager * GetManager() { return &manager; }
 
 private:
 	void OnOpen(wxCommandEvent& event);
+	void OnSaveAs(wxCommandEvent& event);
+	void OnRecord(wxCommandEvent& event);
 	void OnExit(wxCommandEvent& event);
 	void OnAbout(wxCommandEvent& event);
 	void OnNewGesture(CanvasEvent& event);
 	void OnUpdateGesture(CanvasEvent& event);
 	void OnCompleteGesture(CanvasEvent& event);
+	void OnRecognition(wxThreadEvent& event);
+#ifdef OCTOPOCUS_METRICS
+	void OnMetrics(wxTimerEvent& event);
+#endif
+#ifdef OCTOPOCUS_TIMELINE
+	void OnTimeline(wxCommandEvent& event);
+#endif
 
 
-	void FeedForwardAndFeedBack(Gesture *cur, Canvas *canvas);
-	float CalculateFalloff(Gesture *source, Gesture *target);
 
 	DECLARE_EVENT_TABLE()
 
 private:
 	GestureManager manager;
-	Gestures candiates;
+	WorkerPool pool;
+	RecognitionStage stage;		//Does all the matching, off the UI thread.
+	StrokeController controller;
+	TraceRecorder recorder;
+	Canvas *canvas;				//Where the stroke being drawn is.
+#ifdef OCTOPOCUS_METRICS
+	wxTimer metrics_timer;		//Refreshes the summary on the status bar and dumps every metric now and then.
+	int metrics_ticks;
+#endif
+#ifdef OCTOPOCUS_TIMELINE
+	std::string timeline_file;	//Exported to once recording stops.
+#endif
 };
 
 #endif		//OCTOPOCUS_DEMO_H_
\ No newline at end of file
@@ -0,0 +1,314 @@
+#include "recognition_stage.h"
+#include "alloc_check.h"
+#include "metrics.h"
+#include "timeline.h"
+
+#include <assert.h>
+#include <algorithm>
+
+#include <wx/wxprec.h>
+#ifndef WX_PRECOMP
+	#include <wx/wx.h>
+#endif
+
+#include <wx/event.h>
+#include <wx/log.h>
+
+#ifdef _MSC_VER
+	#include <intrin.h>
+	#define COMPARE_AND_SWAP(p, old, value) (_InterlockedCompareExchange((p), (value), (old)) == (old))
+	#define ATOMIC_DECREMENT(p) _InterlockedDecrement(p)
+#else
+	#define COMPARE_AND_SWAP(p, old, value) __sync_bool_compare_and_swap(p, old, value)
+	#define ATOMIC_DECREMENT(p) __sync_sub_and_fetch(p, 1)
+#endif
+
+class RecognitionStage::Thread : public wxThread {
+public:
+	Thread(RecognitionStage *_stage) : wxThread(wxTHREAD_JOINABLE), stage(_stage) {}
+
+protected:
+	virtual ExitCode Entry() {
+		Timeline::NameThread("recognition");
+		stage->Loop();
+		return 0;
+	}
+
+private:
+	RecognitionStage *stage;
+};
+
+/**
+ * Tells the client there is something to pick up. A stage queues at most one at a time (@see notified), so a few slots
+ * made up front serve every round instead of the heap. wx deletes an event once it is handled, which hands its slot
+ * back, on the UI thread. Should every slot be in flight, e.g. with several stages, it falls back to the heap.
+ */
+class RecognitionStage::Notification : public wxThreadEvent {
+public:
+	Notification(int id) : wxThreadEvent(wxEVT_THREAD, id) {}
+
+	static void *operator new(size_t size);
+	static void operator delete(void *p);
+
+private:
+	enum {kSlots = 4};
+
+	//A Notification adds nothing to the event, anything larger goes to the heap.
+	union Slot {
+		char bytes[sizeof(wxThreadEvent)];
+		double align_double;
+		long long align_long;
+		void *align_pointer;
+	};
+
+	static Slot slots[kSlots];
+	static volatile long used[kSlots];
+};
+
+RecognitionStage::Notification::Slot RecognitionStage::Notification::slots[kSlots];
+volatile long RecognitionStage::Notification::used[kSlots];
+
+void *RecognitionStage::Notification::operator new(size_t size) {
+	if(size <= sizeof(Slot)) {
+		for(int i=0; i<kSlots; i++) {
+			if(COMPARE_AND_SWAP(&used[i], 0, 1))
+				return &slots[i];
+		}
+	}
+	return ::operator new(size);
+}
+
+void RecognitionStage::Notification::operator delete(void *p) {
+	Slot *slot = (Slot *)p;
+	if(slot >= slots && slot < slots+kSlots) {
+		ATOMIC_DECREMENT(&used[slot-slots]);
+		return;
+	}
+	::operator delete(p);
+}
+
+RecognitionStage::RecognitionStage(wxEvtHandler *_client, int _event_id, WorkerPool *pool)
+			: client(_client), event_id(_event_id), thread(0), wake(mutex), idle(mutex),
+			quit(false), busy(false), next_stroke(0), begin_pending(false), update_pending(false), pending_id(-1),
+			pending_snapshot(0), notified(false), stroke_id(-1), snapshot(0), pruned(0),
+			front(&buffers[0]), ready(&buffers[1]), back(&buffers[2]), fresh(false) {
+	//Everything an update touches is sized up front, so that updates do not allocate.
+	pending_stroke.Reserve(Gesture::kStrokeReserve);
+	stroke.Reserve(Gesture::kStrokeReserve);
+	for(int i=0; i<3; i++) {
+		buffers[i].items.reserve(FeedForward::kMaxCandidates);
+		buffers[i].labels.reserve(FeedForward::kMaxCandidates);
+	}
+	recognizer.SetPool(pool);
+	thread = new Thread(this);
+	if(thread->Create() != wxTHREAD_NO_ERROR || thread->Run() != wxTHREAD_NO_ERROR) {
+		wxLogError("Cannot start the recognition thread.");
+		delete thread;
+		thread = 0;
+	}
+}
+
+RecognitionStage::~RecognitionStage() {
+	{
+		wxMutexLocker lock(mutex);
+		quit = true;
+		wake.Signal();
+	}
+	if(thread) {
+		thread->Wait();
+		delete thread;
+	}
+	for(int i=0; i<completions.size(); i++) {
+		completions[i].snapshot->Release();
+	}
+	if(pending_snapshot)
+		pending_snapshot->Release();
+	if(snapshot)
+		snapshot->Release();
+}
+
+int RecognitionStage::Begin(const Gesture *s, const GestureSnapshot *t) {
+	t->AddRef();
+	const GestureSnapshot *replaced;
+	{
+		wxMutexLocker lock(mutex);
+		begin_pending = true;
+		update_pending = false;
+		pending_id = next_stroke++;
+		pending_stroke = *s;
+		replaced = pending_snapshot;
+		pending_snapshot = t;
+		wake.Signal();
+	}
+	//Not under the lock, it may be the last reference of a whole library.
+	if(replaced)
+		replaced->Release();
+	return pending_id;
+}
+
+void RecognitionStage::Update(const Gesture *s) {
+	//Overwrite whatever the stage has not picked up yet, only the latest stroke matters.
+	wxMutexLocker lock(mutex);
+	update_pending = true;
+	pending_stroke = *s;
+	wake.Signal();
+}
+
+void RecognitionStage::Complete(const Gesture *s) {
+	wxMutexLocker lock(mutex);
+	if(!pending_snapshot)
+		return;
+	begin_pending = update_pending = false;
+	completions.push_back(Completion());
+	completions.back().id = pending_id;
+	completions.back().stroke = *s;
+	completions.back().snapshot = pending_snapshot;
+	pending_snapshot->AddRef();
+	wake.Signal();
+}
+
+void RecognitionStage::Cancel() {
+	wxMutexLocker lock(mutex);
+	begin_pending = update_pending = false;
+}
+
+void RecognitionStage::Flush() {
+	wxMutexLocker lock(mutex);
+	begin_pending = update_pending = false;
+	for(int i=0; i<completions.size(); i++) {
+		completions[i].snapshot->Release();
+	}
+	completions.clear();
+	while(busy) {
+		idle.Wait();
+	}
+}
+
+const Feedback *RecognitionStage::AcquireFeedback() {
+	{
+		//Anything published from now on needs another event.
+		wxMutexLocker lock(mutex);
+		notified = false;
+	}
+	wxCriticalSectionLocker lock(swap_lock);
+	if(fresh) {
+		std::swap(front, ready);
+		fresh = false;
+	}
+	return front;
+}
+
+bool RecognitionStage::TakeResult(Result *r) {
+	wxMutexLocker lock(mutex);
+	if(results.empty())
+		return false;
+	*r = results.front();
+	results.pop_front();
+	return true;
+}
+
+//Candidates dropped without a full compare.
+static int Pruned(const Recognizer::Stats &s) {
+	return s.length_pruned + s.box_pruned + s.coarse_pruned + s.session_length_pruned + s.session_abandoned;
+}
+
+void RecognitionStage::Loop() {
+	for(;;) {
+		bool begin = false, complete = false;
+		int id = -1;
+		const GestureSnapshot *taken = 0;			//A reference for this round.
+		{
+			wxMutexLocker lock(mutex);
+			busy = false;
+			idle.Broadcast();
+			while(!quit && !begin_pending && !update_pending && completions.empty()) {
+				wake.Wait();
+			}
+			if(quit)
+				return;
+			busy = true;
+
+			//A completion goes first, it may belong to the stroke before the pending one.
+			if(!completions.empty()) {
+				complete = true;
+				id = completions.front().id;
+				completed = completions.front().stroke;
+				taken = completions.front().snapshot;
+				completions.pop_front();
+			}
+			else {
+				begin = begin_pending;
+				id = pending_id;
+				stroke = pending_stroke;
+				if(begin) {
+					taken = pending_snapshot;
+					taken->AddRef();
+				}
+				begin_pending = update_pending = false;
+			}
+		}
+
+		//Begin sized everything, so an update is off the heap up to and including telling the client.
+		AllocCheck check(!complete && !begin && id == stroke_id && stroke.Size() <= Gesture::kStrokeReserve);
+		unsigned long compares = Metrics::Count(Metrics::COMPARE);
+		TimelineSpan span(complete ? "RecognitionStage::Complete" :
+			begin ? "RecognitionStage::Begin" : "RecognitionStage::Update");
+		if(complete) {
+			if(id == stroke_id) {
+				recognizer.End();
+				stroke_id = -1;
+			}
+			Result r;
+			r.stroke = id;
+			const GestureIndex &index = taken->GetIndex();
+			r.match = recognizer.BestMatch(&completed, index, &r.falloff);
+			if(r.match != -1)
+				r.name = index.GetName(r.match);
+			r.stats = recognizer.GetStats();
+			taken->Release();
+			Metrics::Record(Metrics::PRUNED_PER_STROKE, Pruned(r.stats)-pruned);
+			pruned = Pruned(r.stats);
+			{
+				wxMutexLocker lock(mutex);
+				results.push_back(r);
+			}
+		}
+		else {
+			if(begin) {
+				stroke_id = id;
+				recognizer.Begin(&stroke, taken->GetTemplates());
+				//The recognizer has let go of the templates before, so the old snapshot may go.
+				if(snapshot)
+					snapshot->Release();
+				snapshot = taken;
+				feedforward.Begin();
+				feedforward.Present(recognizer, stroke, stroke_id, snapshot->GetTemplates(), back);
+			}
+			else if(id == stroke_id) {
+				recognizer.Update();
+				feedforward.Present(recognizer, stroke, stroke_id, snapshot->GetTemplates(), back);
+			}
+			else {
+				continue;
+			}
+			Publish();
+		}
+		Metrics::Record(Metrics::COMPARES_PER_ROUND, Metrics::Count(Metrics::COMPARE)-compares);
+
+		//The client picks up everything there is on one event, so there is no need to queue another one.
+		wxMutexLocker lock(mutex);
+		if(!notified) {
+			notified = true;
+			Notification *event = new Notification(event_id);
+			//Queueing allocates inside wx.
+			AllocCheck::Exempt exempt;
+			wxQueueEvent(client, event);
+		}
+	}
+}
+
+void RecognitionStage::Publish() {
+	wxCriticalSectionLocker lock(swap_lock);
+	std::swap(back, ready);
+	fresh = true;
+}
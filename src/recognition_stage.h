@@ -0,0 +1,125 @@
+#ifndef RECOGNITION_STAGE_H_
+#define RECOGNITION_STAGE_H_
+
+#include "gesture.h"
+#include "gesture_snapshot.h"
+#include "feedback.h"
+#include "feedforward.h"
+#include "recognizer.h"
+
+#include <deque>
+#include <string>
+#include <vector>
+#include <utility>
+
+#include <wx/thread.h>
+
+class wxEvtHandler;
+class WorkerPool;
+
+/**
+ * Runs the recognizer on a thread of its own, so that input handling on the UI thread never waits for matching.
+ *
+ * The UI thread hands over snapshots of the stroke. Only the latest one is kept: if matching falls behind, the
+ * snapshots in between are dropped and the next round starts from the newest stroke, so latency does not pile up.
+ * Each round produces a Feedback which is published through three buffers, one being drawn by the UI thread, one
+ * being filled by the stage and one ready to be picked up. Publishing and picking up only swap two pointers, and the
+ * buffer being drawn is never touched by the stage, so painting does not lock anything.
+ *
+ * After every round a wxThreadEvent with the given id is queued to the client, which then calls AcquireFeedback()
+ * and TakeResult() on the UI thread. Rounds finished before the client gets to it share one event.
+ *
+ * Once a stroke has begun, updates do not allocate on either side as long as the stroke stays within
+ * Gesture::kStrokeReserve points, @see AllocCheck.
+ *
+ * Each stroke is matched against the GestureSnapshot it began with, which the stage holds until the stroke and its
+ * completion are done with it, so templates may be loaded meanwhile. Feedback points into that snapshot as well.
+ */
+class RecognitionStage {
+public:
+	//Final match of a complete stroke.
+	struct Result {
+		int stroke;
+		int match;					//Id in the snapshot of the stroke, -1 if nothing matches.
+		std::string name;
+		float falloff;
+		Recognizer::Stats stats;	//Accumulated so far.
+
+		Result() : stroke(-1), match(-1), falloff(0.0f) {}
+	};
+
+private:
+	class Thread;
+	class Notification;
+
+public:
+	//client receives the events and pool spreads the matching, neither is owned.
+	RecognitionStage(wxEvtHandler *client, int event_id, WorkerPool *pool);
+	~RecognitionStage();
+
+	/****************UI thread only.****************/
+	//Start a new stroke against the templates of snapshot, return its id. The stage takes a reference of its own.
+	int Begin(const Gesture *stroke, const GestureSnapshot *snapshot);
+	//The stroke has grown.
+	void Update(const Gesture *stroke);
+	//The stroke is complete, find the final match. Unlike updates, a completion is never dropped.
+	void Complete(const Gesture *stroke);
+	//Drop the stroke being tracked, e.g. it is cancelled.
+	void Cancel();
+	//Drop anything pending and wait until the stage is idle, e.g. before using the pool for something else.
+	void Flush();
+
+	//The most recent Feedback published, which stays valid and unchanged until the next call.
+	const Feedback *AcquireFeedback();
+	//Return true and fill result with the oldest completion done and not taken yet. Results come in completion order.
+	bool TakeResult(Result *result);
+
+private:
+	void Loop();
+	void Publish();
+
+private:
+	wxEvtHandler *client;
+	int event_id;
+	Thread *thread;
+
+	//Shared with the stage thread, guarded by mutex.
+	wxMutex mutex;
+	wxCondition wake, idle;
+	bool quit;
+	bool busy;
+	int next_stroke;			//Id for the next Begin.
+	//Latest copy of the stroke, begin means a new stroke against pending_snapshot.
+	bool begin_pending, update_pending;
+	int pending_id;
+	Gesture pending_stroke;
+	const GestureSnapshot *pending_snapshot;		//Of the latest Begin, 0 before any.
+	//Completions are queued, strokes completed faster than they are matched must not overwrite each other.
+	struct Completion {
+		int id;
+		Gesture stroke;
+		const GestureSnapshot *snapshot;			//Held until matched.
+	};
+	std::deque<Completion> completions;
+	std::deque<Result> results;
+	bool notified;				//An event is queued to the client and not handled yet.
+
+	//Stage thread only.
+	Recognizer recognizer;
+	Gesture stroke;
+	int stroke_id;				//-1 if not tracking any.
+	const GestureSnapshot *snapshot;				//Of stroke, held until the next begins.
+	Gesture completed;
+	int pruned;					//Recognizer::Stats pruned so far, @see Metrics::PRUNED_PER_STROKE.
+	FeedForward feedforward;
+
+	//Three buffers, each pointer owned by one party at any time. Only swapping is guarded, by swap_lock.
+	Feedback buffers[3];
+	Feedback *front;			//UI thread, being drawn.
+	Feedback *ready;			//Published, not picked up yet if fresh.
+	Feedback *back;				//Stage thread, being filled.
+	bool fresh;
+	wxCriticalSection swap_lock;
+};
+
+#endif			//RECOGNITION_STAGE_H_
@@ -0,0 +1,205 @@
+#include "recognizer.h"
+#include "gesture.h"
+#include "worker_pool.h"
+
+#include <limits>
+#include <algorithm>
+
+//Things that are configurable.
+static const float kErrorThreshod = 50.0f;
+static const float kLengthUpThreshold = 1.2f;
+static const float kLengthLowThreshold = 0.9f;
+
+void Recognizer::Stats::Reset() {
+	compares = 0;
+	length_pruned = 0;
+	box_pruned = 0;
+	coarse_pruned = 0;
+	full_pruned = 0;
+	accepted = 0;
+	session_length_pruned = 0;
+	session_abandoned = 0;
+	index_distances = 0;
+	index_compares = 0;
+}
+
+void Recognizer::Stats::Add(const Stats &rhs) {
+	compares += rhs.compares;
+	length_pruned += rhs.length_pruned;
+	box_pruned += rhs.box_pruned;
+	coarse_pruned += rhs.coarse_pruned;
+	full_pruned += rhs.full_pruned;
+	accepted += rhs.accepted;
+	session_length_pruned += rhs.session_length_pruned;
+	session_abandoned += rhs.session_abandoned;
+	index_distances += rhs.index_distances;
+	index_compares += rhs.index_compares;
+}
+
+Recognizer::Recognizer() : pool(0) {
+	session.SetLimits(kErrorThreshod, kLengthUpThreshold);
+}
+
+void Recognizer::SetPool(WorkerPool *p) {
+	pool = p;
+	session.SetPool(p);
+}
+
+void Recognizer::Begin(const Gesture *stroke, const Gestures &templates) {
+	End();
+	session.Begin(stroke, templates);
+	//Rank never holds more than the templates, so updates don't grow it.
+	ranking.reserve(templates.size());
+}
+
+void Recognizer::Update() {
+	session.Update();
+}
+
+float Recognizer::Falloff(int index) const {
+	return ErrorToFalloff(session.Error(index));
+}
+
+void Recognizer::Rank(int k, std::vector<int> *result) {
+	result->clear();
+	ranking.clear();
+	const std::vector<int> &active = session.Active();
+	for(int i=0; i<active.size(); i++) {
+		float error = session.Error(active[i]);
+		if(ErrorToFalloff(error) > 0.0f)
+			ranking.push_back(std::make_pair(error, active[i]));
+	}
+
+	//Ties go to the lower index, so the order is stable between updates.
+	int size = k < ranking.size() ? k : ranking.size();
+	std::partial_sort(ranking.begin(), ranking.begin()+size, ranking.end());
+	for(int i=0; i<size; i++) {
+		result->push_back(ranking[i].second);
+	}
+}
+
+void Recognizer::End() {
+	stats.session_length_pruned += session.LengthPruned();
+	stats.session_abandoned += session.Abandoned();
+	session.Clear();
+}
+
+float Recognizer::Falloff(const Gesture *source, const Gesture *target) {
+	return ErrorToFalloff(Cascade(source, target, kErrorThreshod, &stats));
+}
+
+//Best match among a chunk of templates, starting from the full threshold so that chunks don't depend on each other.
+class Recognizer::BestMatchTask : public WorkerPool::Task {
+public:
+	BestMatchTask(const Gesture *_source, const Gestures &_templates, int chunk_count)
+		: source(_source), templates(_templates), results(chunk_count) {}
+
+	virtual void Run(int chunk, int begin, int end) {
+		ChunkResult &result = results[chunk];
+		result.match = -1;
+		result.falloff = 0.0f;
+		float bound = kErrorThreshod;
+		for(int i=begin; i<end; i++) {
+			const Gesture *target = templates[i].second;
+			float length_ratio = source->Length() / target->Length();
+			if(length_ratio < kLengthLowThreshold) {
+				result.stats.compares++;
+				result.stats.length_pruned++;
+				continue;
+			}
+
+			//Anything with a larger error than the best one so far can't have a larger falloff.
+			float error = Cascade(source, target, bound, &result.stats);
+			if(error > bound)
+				continue;
+			float temp = ErrorToFalloff(error);
+			if(temp == 0.0f)
+				continue;
+
+			if(temp > result.falloff) {
+				result.falloff = temp;
+				result.match = i;
+				bound = error;
+			}
+		}
+	}
+
+	const std::vector<ChunkResult> &GetResults() const { return results; }
+
+private:
+	const Gesture *source;
+	const Gestures &templates;
+	std::vector<ChunkResult> results;
+};
+
+int Recognizer::BestMatch(const Gesture *source, const Gestures &templates, float *falloff) {
+	int size = templates.size();
+	if(pool) {
+		BestMatchTask task(source, templates, WorkerPool::ChunkCount(size, kChunkSize));
+		pool->Run(&task, size, kChunkSize);
+		return Reduce(task.GetResults(), falloff);
+	}
+	BestMatchTask task(source, templates, 1);
+	task.Run(0, 0, size);
+	return Reduce(task.GetResults(), falloff);
+}
+
+int Recognizer::Reduce(const std::vector<ChunkResult> &results, float *falloff) {
+	//In chunk order, the first of equal falloffs wins just like a single pass does.
+	int best_match = -1;
+	float best_falloff = 0.0f;
+	for(int i=0; i<results.size(); i++) {
+		stats.Add(results[i].stats);
+		if(results[i].falloff > best_falloff) {
+			best_falloff = results[i].falloff;
+			best_match = results[i].match;
+		}
+	}
+
+	if(falloff)
+		*falloff = best_falloff;
+	return best_match;
+}
+
+int Recognizer::BestMatch(const Gesture *source, const GestureIndex &index, float *falloff) {
+	std::vector<GestureIndex::Match> matches;
+	GestureIndex::Stats index_stats;
+	index.Nearest(source, 1, kErrorThreshod, kLengthLowThreshold, kLengthUpThreshold, &matches, &index_stats, pool);
+	stats.index_distances += index_stats.distances;
+	stats.index_compares += index_stats.compares;
+
+	float best_falloff = matches.empty() ? 0.0f : ErrorToFalloff(matches[0].error);
+	if(falloff)
+		*falloff = best_falloff;
+	return best_falloff == 0.0f ? -1 : matches[0].id;
+}
+
+float Recognizer::Cascade(const Gesture *source, const Gesture *target, float bound, Stats *stats) {
+	stats->compares++;
+	if(source->Length() > target->Length()*kLengthUpThreshold) {
+		stats->length_pruned++;
+		return std::numeric_limits<float>::infinity();
+	}
+	if(source->BoxBound(*target) > bound) {
+		stats->box_pruned++;
+		return std::numeric_limits<float>::infinity();
+	}
+	if(source->CoarseBound(*target) > bound) {
+		stats->coarse_pruned++;
+		return std::numeric_limits<float>::infinity();
+	}
+
+	float error = source->Compare(*target, bound);
+	if(error > bound)
+		stats->full_pruned++;
+	else
+		stats->accepted++;
+	return error;
+}
+
+float Recognizer::ErrorToFalloff(float error) {
+	if(error > kErrorThreshod)
+		return 0.0f;
+	else
+		return 1.0f - error/kErrorThreshod;
+}
@@ -0,0 +1,115 @@
+#ifndef RECOGNIZER_H_
+#define RECOGNIZER_H_
+
+#include "match_session.h"
+#include "gesture_index.h"
+
+#include <string>
+#include <vector>
+#include <utility>
+
+class Gesture;
+class WorkerPool;
+
+/**
+ * Turns the Compare error between the stroke and templates into falloff, and picks the final match.
+ *
+ * Candidates go through a cascade, cheapest test first, and drop out at the first stage that proves they can't match:
+ *		1. length ratio.
+ *		2. bounding box distance, @see Gesture::BoxBound().
+ *		3. the coarse level of the template descriptor, @see Gesture::CoarseBound().
+ *		4. full resolution bounded Compare, which gives up half way once the error is known to be too large.
+ * Every stage is a strict lower bound of the error, so the cascade never changes the result, only its cost.
+ *
+ * The stroke being drawn is tracked incrementally by a MatchSession, which applies the same limits as it goes.
+ */
+class Recognizer {
+public:
+	typedef std::vector<std::pair<std::string, const Gesture *> > Gestures;
+
+	//How many candidates each stage rejected, accumulated until ResetStats(). Mainly for tuning.
+	struct Stats {
+		int compares;				//Candidates entering the cascade.
+		int length_pruned;
+		int box_pruned;
+		int coarse_pruned;
+		int full_pruned;			//Rejected by the full resolution compare, most of them half way.
+		int accepted;
+
+		//Same for strokes in progress, @see MatchSession.
+		int session_length_pruned;
+		int session_abandoned;
+
+		//Searches through a GestureIndex, @see GestureIndex::Stats.
+		int index_distances;
+		int index_compares;
+
+		Stats() { Reset(); }
+		void Reset();
+		void Add(const Stats &rhs);
+	};
+
+private:
+	class BestMatchTask;
+	//Best match of a chunk of templates.
+	struct ChunkResult {
+		int match;
+		float falloff;
+		Stats stats;
+	};
+
+	enum {kChunkSize = 64};		//Templates per chunk of work given to the pool.
+
+public:
+	Recognizer();
+
+	/**
+	 * Spread the work over pool, which is not owned. 0 to run on the calling thread only.
+	 * Results are the same either way, the stage counters may differ as the bound is tightened per chunk.
+	 */
+	void SetPool(WorkerPool *pool);
+
+	/****************Incremental, for the stroke being drawn.****************/
+	//On NEW_GESTURE. stroke is not owned.
+	void Begin(const Gesture *stroke, const Gestures &templates);
+	//On UPDATE_GESTURE.
+	void Update();
+	//Falloff in [0.0, 1.0] of templates[index] against the stroke, 0.0 means it doesn't match at all.
+	float Falloff(int index) const;
+	/**
+	 * Up to k templates with the largest falloff, best first, as index into templates. Templates with no falloff are
+	 * left out. Only candidates still alive in the session are looked at, and those are partially sorted, so the cost
+	 * shrinks as the stroke goes on and prunes the library.
+	 */
+	void Rank(int k, std::vector<int> *result);
+	const Gesture *GetStroke() const { return session.GetQuery(); }
+	void End();
+
+	/****************One shot.****************/
+	float Falloff(const Gesture *source, const Gesture *target);
+
+	/**
+	 * Best match for a complete gesture, -1 if nothing matches.
+	 * Once a match is found, its error becomes the bound for the rest, so later candidates drop out even earlier.
+	 */
+	int BestMatch(const Gesture *source, const Gestures &templates, float *falloff = 0);
+	//Same as above through an index, return the id in index.
+	int BestMatch(const Gesture *source, const GestureIndex &index, float *falloff = 0);
+
+	const Stats &GetStats() const { return stats; }
+	void ResetStats() { stats.Reset(); }
+
+private:
+	//Run the cascade, return the error if it is no greater than bound, otherwise something greater than bound.
+	static float Cascade(const Gesture *source, const Gesture *target, float bound, Stats *stats);
+	int Reduce(const std::vector<ChunkResult> &results, float *falloff);
+	static float ErrorToFalloff(float error);
+
+private:
+	WorkerPool *pool;
+	MatchSession session;
+	Stats stats;
+	std::vector<std::pair<float, int> > ranking;		//Scratch of Rank, error and index.
+};
+
+#endif			//RECOGNIZER_H_
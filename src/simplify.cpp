@@ -0,0 +1,66 @@
+#include "simplify.h"
+
+#include <utility>
+#include <vector>
+
+namespace simplify {
+	int Rdp(float *x, float *y, int n, float tolerance) {
+		if(tolerance <= 0.0f || n <= 2)
+			return n;
+
+		//Ranges still to be split, kept on a stack instead of recursing, as a gesture may have a million points.
+		std::vector<char> keep(n, 0);
+		keep[0] = keep[n-1] = 1;
+		std::vector<std::pair<int, int> > ranges;
+		ranges.push_back(std::make_pair(0, n-1));
+		float limit = tolerance*tolerance;
+		while(!ranges.empty()) {
+			int first = ranges.back().first, last = ranges.back().second;
+			ranges.pop_back();
+			if(last-first < 2)
+				continue;
+
+			//Farthest point from the chord, or from the first point if the chord has no length.
+			float dx = x[last]-x[first], dy = y[last]-y[first];
+			float chord = dx*dx + dy*dy;
+			int farthest = -1;
+			float max_distance = limit;
+			for(int i=first+1; i<last; i++) {
+				float px = x[i]-x[first], py = y[i]-y[first];
+				float d;
+				if(chord == 0.0f) {
+					d = px*px + py*py;
+				}
+				else {
+					float cross = px*dy - py*dx;
+					d = cross*cross/chord;
+					//Past either end the distance is to that end.
+					float t = (px*dx + py*dy)/chord;
+					if(t < 0.0f)
+						d = px*px + py*py;
+					else if(t > 1.0f)
+						d = (x[i]-x[last])*(x[i]-x[last]) + (y[i]-y[last])*(y[i]-y[last]);
+				}
+				if(d > max_distance) {
+					max_distance = d;
+					farthest = i;
+				}
+			}
+			if(farthest == -1)
+				continue;
+			keep[farthest] = 1;
+			ranges.push_back(std::make_pair(first, farthest));
+			ranges.push_back(std::make_pair(farthest, last));
+		}
+
+		int size = 0;
+		for(int i=0; i<n; i++) {
+			if(keep[i]) {
+				x[size] = x[i];
+				y[size] = y[i];
+				size++;
+			}
+		}
+		return size;
+	}
+}
@@ -0,0 +1,21 @@
+#ifndef SIMPLIFY_H_
+#define SIMPLIFY_H_
+
+/**
+ * Polyline simplification of templates, which are complete before they are used. Strokes being drawn are simplified
+ * online as points come, @see Gesture::SetSimplify().
+ *
+ * Tolerance: every point removed lies within tolerance pixels of the simplified polyline, and the end points are
+ * kept. The simplified polyline is never longer than the original one, it only loses the wiggles smaller than
+ * tolerance. Compare samples both by arc length, so the error it reports moves by about tolerance at most, less on
+ * smooth gestures where almost nothing but collinear points go.
+ */
+namespace simplify {
+	/**
+	 * Ramer-Douglas-Peucker. Keep the points needed to stay within tolerance of x, y [0, n), compacting them to the
+	 * front of x and y in order. Return how many are kept, n if tolerance is not positive.
+	 */
+	int Rdp(float *x, float *y, int n, float tolerance);
+}
+
+#endif			//SIMPLIFY_H_
@@ -0,0 +1,91 @@
+#include "stroke_controller.h"
+#include "stroke_trace.h"
+#include "gesture.h"
+#include "gesture_manager.h"
+#include "metrics.h"
+
+//Things that are configurable.
+static const float kCancelThreshold = 20.0f;
+
+StrokeController::StrokeController(RecognitionStage *_stage, GestureManager *_manager)
+			: stage(_stage), manager(_manager), recorder(0), stroke(-1),
+			recorded(0), recorded_x(0.0f), recorded_y(0.0f) {
+
+}
+
+void StrokeController::Begin(const Gesture *g) {
+	if(recorder) {
+		Gesture::Point p = g->Back();
+		recorder->Add(StrokeTrace::DOWN, p.x+g->GetAnchor().x, p.y+g->GetAnchor().y);
+		recorded = 1;
+		recorded_x = p.x;
+		recorded_y = p.y;
+	}
+	//The stage keeps its own reference for as long as the stroke needs the templates.
+	const GestureSnapshot *snapshot = manager->GetSnapshot();
+	stroke = stage->Begin(g, snapshot);
+	snapshot->Release();
+}
+
+void StrokeController::RecordPoints(const Gesture *g) {
+	int first = recorded;
+	if(recorded > 0 && recorded <= g->Size()) {
+		Gesture::Point last = g->Get(recorded-1);
+		if(last.x != recorded_x || last.y != recorded_y)
+			first = recorded-1;
+	}
+	Gesture::Point anchor = g->GetAnchor();
+	long long time = recorder->Now();
+	for(int i=first; i<g->Size(); i++) {
+		Gesture::Point p = g->Get(i);
+		recorder->Add(StrokeTrace::MOVE, p.x+anchor.x, p.y+anchor.y, time);
+	}
+	recorded = g->Size();
+	Gesture::Point tip = g->Back();
+	recorded_x = tip.x;
+	recorded_y = tip.y;
+}
+
+void StrokeController::Update(const Gesture *g) {
+	if(recorder)
+		RecordPoints(g);
+	//Feedback shows up once the stage is done with it, @see AcquireFeedback().
+	stage->Update(g);
+}
+
+bool StrokeController::Complete(const Gesture *g) {
+	Gesture::Point head = g->Front();
+	Gesture::Point tail = g->Back();
+	if(recorder) {
+		RecordPoints(g);
+		recorder->Add(StrokeTrace::UP, tail.x+g->GetAnchor().x, tail.y+g->GetAnchor().y);
+	}
+	stroke = -1;
+	Metrics::Record(Metrics::POINTS_PER_STROKE, g->Size());
+	Metrics::Record(Metrics::SIMPLIFIED_PER_STROKE, g->Simplified());
+
+	//Check whether gesture is valid or get cancelled.
+	if(Gesture::Point::Distance(head, tail) < kCancelThreshold) {
+		stage->Cancel();
+		if(recorder)
+			recorder->AddResult(StrokeTrace::CANCEL, "");
+		return false;
+	}
+	//Check match, the result comes back through TakeResult().
+	stage->Complete(g);
+	return true;
+}
+
+const Feedback *StrokeController::AcquireFeedback() {
+	//Feedback of a stroke that is over by now is of no use.
+	const Feedback *feedback = stage->AcquireFeedback();
+	return stroke != -1 && feedback->stroke == stroke ? feedback : 0;
+}
+
+bool StrokeController::TakeResult(RecognitionStage::Result *result) {
+	if(!stage->TakeResult(result))
+		return false;
+	if(recorder)
+		recorder->AddResult(StrokeTrace::RESULT, result->match == -1 ? "" : result->name);
+	return true;
+}
@@ -0,0 +1,53 @@
+#ifndef STROKE_CONTROLLER_H_
+#define STROKE_CONTROLLER_H_
+
+#include "recognition_stage.h"
+
+class Gesture;
+class GestureManager;
+class TraceRecorder;
+struct Feedback;
+
+/**
+ * What happens to a stroke apart from drawing it, on NEW_GESTURE, UPDATE_GESTURE and COMPLETE_GESTURE: it is handed
+ * to a RecognitionStage as it grows, matched against the gestures of a GestureManager once complete, or cancelled if
+ * it ends close to where it began.
+ *
+ * It knows nothing about windows, so a trace of strokes can be replayed through the very same logic without one.
+ * With a TraceRecorder set, every stroke event and result is recorded as it goes. An update may cover several points,
+ * e.g. the moves of a frame, they are recorded as moves at the same time, @see Canvas::SetFrameRate().
+ * Everything is called on the thread owning the stage client, the UI thread in the demo.
+ */
+class StrokeController {
+public:
+	//Neither is owned.
+	StrokeController(RecognitionStage *stage, GestureManager *manager);
+
+	void Begin(const Gesture *stroke);
+	void Update(const Gesture *stroke);
+	//Return false if the stroke is cancelled, otherwise its result comes with a later stage event.
+	bool Complete(const Gesture *stroke);
+
+	/****************On the stage event.****************/
+	//Feedback of the stroke being drawn, 0 if the latest one belongs to a stroke that is over.
+	const Feedback *AcquireFeedback();
+	//Return true and fill result if a stroke has been matched since the last call.
+	bool TakeResult(RecognitionStage::Result *result);
+
+	//Record into recorder from now on, 0 to stop. Not owned.
+	void SetRecorder(TraceRecorder *r) { recorder = r; }
+
+private:
+	//Record the points of stroke the trace does not have yet.
+	void RecordPoints(const Gesture *stroke);
+
+private:
+	RecognitionStage *stage;
+	GestureManager *manager;
+	TraceRecorder *recorder;
+	int stroke;					//Id of the stroke being drawn, -1 if none.
+	int recorded;				//Points of it in the trace.
+	float recorded_x, recorded_y;		//Last of them, simplification may move it.
+};
+
+#endif			//STROKE_CONTROLLER_H_
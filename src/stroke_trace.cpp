@@ -0,0 +1,108 @@
+#include "stroke_trace.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <fstream>
+#include <sstream>
+
+static const char kHeader[] = "octopocus-trace 1";
+static const char *kTypeNames[] = {"down", "move", "up", "result", "cancel"};
+
+const char *StrokeTrace::TypeName(Type type) {
+	return kTypeNames[type];
+}
+
+bool StrokeTrace::Load(const std::string &file_name) {
+	events.clear();
+	error.clear();
+	std::ifstream file(file_name.c_str());
+	if(!file.is_open()) {
+		error = "cannot open file";
+		return false;
+	}
+	std::string line;
+	if(!std::getline(file, line) || line.compare(0, sizeof(kHeader)-1, kHeader) != 0) {
+		error = "not a stroke trace";
+		return false;
+	}
+
+	for(int number=2; std::getline(file, line); number++) {
+		if(!line.empty() && line[line.size()-1] == '\r')
+			line.erase(line.size()-1);
+		if(line.empty())
+			continue;
+		std::istringstream stream(line);
+		Event e;
+		std::string type;
+		stream>>e.time>>type;
+		int t = 0;
+		for(; t<sizeof(kTypeNames)/sizeof(kTypeNames[0]) && type != kTypeNames[t]; t++);
+		bool ok = !stream.fail() && t < sizeof(kTypeNames)/sizeof(kTypeNames[0]);
+		e.type = (Type)t;
+		if(ok && (e.type == DOWN || e.type == MOVE || e.type == UP)) {
+			stream>>e.x>>e.y;
+			ok = !stream.fail();
+		}
+		else if(ok && e.type == RESULT) {
+			//The rest of the line, names may have spaces.
+			std::getline(stream, e.name);
+			if(!e.name.empty() && e.name[0] == ' ')
+				e.name.erase(0, 1);
+		}
+		if(!ok) {
+			std::ostringstream message;
+			message<<"line "<<number<<": expected time, event and its values";
+			error = message.str();
+			return false;
+		}
+		events.push_back(e);
+	}
+	return true;
+}
+
+TraceRecorder::TraceRecorder() : file(0) {
+
+}
+
+TraceRecorder::~TraceRecorder() {
+	Close();
+}
+
+bool TraceRecorder::Open(const std::string &file_name) {
+	Close();
+	file = fopen(file_name.c_str(), "w");
+	if(!file)
+		return false;
+	fprintf(file, "%s\n", kHeader);
+	clock.Start();
+	return true;
+}
+
+void TraceRecorder::Close() {
+	if(file)
+		fclose(file);
+	file = 0;
+}
+
+long long TraceRecorder::Now() const {
+	return (long long)clock.TimeInMicro().GetValue();
+}
+
+void TraceRecorder::Add(StrokeTrace::Type type, float x, float y) {
+	Add(type, x, y, Now());
+}
+
+void TraceRecorder::Add(StrokeTrace::Type type, float x, float y, long long time) {
+	if(file)
+		fprintf(file, "%lld %s %g %g\n", time, StrokeTrace::TypeName(type), x, y);
+}
+
+void TraceRecorder::AddResult(StrokeTrace::Type type, const std::string &name) {
+	if(!file)
+		return;
+	fprintf(file, "%lld %s", Now(), StrokeTrace::TypeName(type));
+	if(type == StrokeTrace::RESULT && !name.empty())
+		fprintf(file, " %s", name.c_str());
+	fprintf(file, "\n");
+}
@@ -0,0 +1,74 @@
+#ifndef STROKE_TRACE_H_
+#define STROKE_TRACE_H_
+
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+#include <wx/stopwatch.h>
+
+/**
+ * Timestamped input of strokes, recorded from the demo and replayed without a window, so that latency and accuracy
+ * can be measured on the same strokes again and again.
+ *
+ * Text, one event per line after a header line, times in microseconds since recording started:
+ *		octopocus-trace 1
+ *		<time> down <x> <y>			mouse pressed, a stroke begins at x, y in canvas pixels
+ *		<time> move <x> <y>			the stroke grows, moves at the same time were handed over in one update
+ *		<time> up <x> <y>			released
+ *		<time> result <name>		what the stroke was matched to, nothing after result if it matched none
+ *		<time> cancel				the stroke was cancelled instead
+ * Results are optional, a replay compares against them if they are there.
+ */
+class StrokeTrace {
+public:
+	enum Type {DOWN, MOVE, UP, RESULT, CANCEL};
+
+	struct Event {
+		Type type;
+		long long time;
+		float x, y;
+		std::string name;			//RESULT only.
+
+		Event() : type(DOWN), time(0), x(0.0f), y(0.0f) {}
+	};
+
+public:
+	//On failure GetError() tells why.
+	bool Load(const std::string &file_name);
+	const std::string &GetError() const { return error; }
+	const std::vector<Event> &GetEvents() const { return events; }
+
+	static const char *TypeName(Type type);
+
+private:
+	std::vector<Event> events;
+	std::string error;
+};
+
+//Writes a StrokeTrace as events happen.
+class TraceRecorder {
+public:
+	TraceRecorder();
+	~TraceRecorder();
+
+	//Start a new trace, timed from now on.
+	bool Open(const std::string &file_name);
+	void Close();
+	bool IsOpen() const { return file != 0; }
+
+	//DOWN, MOVE or UP at canvas pixels x, y.
+	void Add(StrokeTrace::Type type, float x, float y);
+	//Same at time, microseconds since Open. Moves at the same time replay as one update.
+	void Add(StrokeTrace::Type type, float x, float y, long long time);
+	long long Now() const;
+	//RESULT or CANCEL, name is empty if nothing matches.
+	void AddResult(StrokeTrace::Type type, const std::string &name);
+
+private:
+	FILE *file;
+	wxStopWatch clock;
+};
+
+#endif			//STROKE_TRACE_H_
@@ -0,0 +1,143 @@
+#include "timeline.h"
+#include "metrics.h"
+
+#ifdef OCTOPOCUS_TIMELINE
+
+#include <stdio.h>
+
+#ifdef _MSC_VER
+	#include <intrin.h>
+	#define THREAD_LOCAL __declspec(thread)
+	#define ATOMIC_INCREMENT(p) _InterlockedIncrement(p)
+	#define COMPARE_AND_SWAP(p, old, value) \
+		(_InterlockedCompareExchangePointer((void *volatile *)(p), (value), (old)) == (old))
+#else
+	#define THREAD_LOCAL __thread
+	#define ATOMIC_INCREMENT(p) __sync_add_and_fetch(p, 1)
+	#define COMPARE_AND_SWAP(p, old, value) __sync_bool_compare_and_swap(p, old, value)
+#endif
+
+namespace {
+	struct Span {
+		const char *name;
+		unsigned long long begin, end;
+	};
+
+	//Written by its thread only. Start() does not touch it, the thread drops old spans itself on the next Add.
+	struct Buffer {
+		Span spans[Timeline::kBufferSize];
+		volatile long size;			//Spans below are complete.
+		volatile long dropped;
+		long generation;			//Of the Start() the spans belong to.
+		const char *name;
+		long id;
+		Buffer *next;
+	};
+}
+
+//Every thread that ever recorded, never freed as threads come and go with the pool.
+static Buffer *volatile buffers = 0;
+static volatile long thread_count = 0;
+static THREAD_LOCAL Buffer *own = 0;
+
+static volatile bool recording = false;
+static volatile long generation = 0;
+static unsigned long long origin = 0;
+
+//Buffer of the calling thread, allocated and linked in on first use.
+static Buffer *Own() {
+	if(own)
+		return own;
+	Buffer *b = new Buffer;
+	b->size = 0;
+	b->dropped = 0;
+	b->generation = generation;
+	b->name = 0;
+	b->id = ATOMIC_INCREMENT(&thread_count);
+	do {
+		b->next = buffers;
+	} while(!COMPARE_AND_SWAP(&buffers, b->next, b));
+	own = b;
+	return b;
+}
+
+void Timeline::Start() {
+	origin = Metrics::Now();
+	ATOMIC_INCREMENT(&generation);
+	recording = true;
+}
+
+void Timeline::Stop() {
+	recording = false;
+}
+
+bool Timeline::IsRecording() {
+	return recording;
+}
+
+void Timeline::Add(const char *name, unsigned long long begin, unsigned long long end) {
+	if(!recording)
+		return;
+	Buffer *b = Own();
+	if(b->generation != generation) {
+		b->size = 0;
+		b->dropped = 0;
+		b->generation = generation;
+	}
+	if(b->size == kBufferSize) {
+		b->dropped++;
+		return;
+	}
+	Span &s = b->spans[b->size];
+	s.name = name;
+	s.begin = begin;
+	s.end = end;
+	b->size++;
+}
+
+void Timeline::NameThread(const char *name) {
+	//Allocating here also keeps the first span of the thread off the heap.
+	Own()->name = name;
+}
+
+bool Timeline::Export(const std::string &file) {
+	FILE *f = fopen(file.c_str(), "w");
+	if(!f)
+		return false;
+	fprintf(f, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n");
+	bool first = true;
+	long dropped = 0;
+	for(Buffer *b=buffers; b; b=b->next) {
+		if(b->name) {
+			fprintf(f, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %ld, \"args\": {\"name\": \"%s\"}}",
+				first ? "" : ",\n", b->id, b->name);
+			first = false;
+		}
+		if(b->generation != generation)
+			continue;
+		long size = b->size;
+		dropped += b->dropped;
+		for(long i=0; i<size; i++) {
+			const Span &s = b->spans[i];
+			if(s.begin < origin)
+				continue;
+			//Microseconds since Start().
+			fprintf(f, "%s{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %ld, \"ts\": %.3f, \"dur\": %.3f}",
+				first ? "" : ",\n", s.name, b->id, (s.begin-origin)/1e3, (s.end-s.begin)/1e3);
+			first = false;
+		}
+	}
+	fprintf(f, "\n], \"otherData\": {\"dropped\": %ld}}\n", dropped);
+	return fclose(f) == 0;
+}
+
+TimelineSpan::TimelineSpan(const char *_name) : name(_name), begin(recording ? Metrics::Now() : 0) {
+
+}
+
+TimelineSpan::~TimelineSpan() {
+	if(begin)
+		Timeline::Add(name, begin, Metrics::Now());
+}
+
+#endif			//OCTOPOCUS_TIMELINE
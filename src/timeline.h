@@ -0,0 +1,61 @@
+#ifndef TIMELINE_H_
+#define TIMELINE_H_
+
+#include <string>
+
+/**
+ * Spans of what each thread does and when, exported as Chrome trace event JSON to be looked at in a timeline viewer,
+ * e.g. chrome://tracing or Perfetto. Where Metrics tells how long things take, a timeline tells in which order they
+ * happen, e.g. a paint landing between two updates of a stroke.
+ *
+ * Define OCTOPOCUS_TIMELINE to enable it. Each thread appends to a fixed buffer of its own, so recording a span takes
+ * no lock and does not allocate once the thread has recorded its first one. A full buffer drops further spans, the
+ * export tells how many. Spans are only kept between Start() and Stop().
+ * Without the define Timeline and TimelineSpan are empty inline functions, so instrumented code costs nothing.
+ */
+class Timeline {
+public:
+	enum {kBufferSize = 1 << 16};		//Spans kept per thread.
+
+#ifdef OCTOPOCUS_TIMELINE
+public:
+	//Drop whatever is recorded so far and record from now on.
+	static void Start();
+	static void Stop();
+	static bool IsRecording();
+
+	//name must outlive the export, e.g. a literal.
+	static void Add(const char *name, unsigned long long begin, unsigned long long end);
+	//Name the calling thread in the export.
+	static void NameThread(const char *name);
+
+	//Every span recorded as Chrome trace event JSON, overwriting file. Call after Stop().
+	static bool Export(const std::string &file);
+
+#else
+public:
+	static void Start() {}
+	static void Stop() {}
+	static bool IsRecording() { return false; }
+	static void NameThread(const char *name) {}
+	static bool Export(const std::string &file) { return true; }
+#endif			//OCTOPOCUS_TIMELINE
+};
+
+//Record a span from construction to destruction, name must be a literal.
+class TimelineSpan {
+#ifdef OCTOPOCUS_TIMELINE
+public:
+	explicit TimelineSpan(const char *_name);
+	~TimelineSpan();
+
+private:
+	const char *name;
+	unsigned long long begin;		//0 if not recording.
+#else
+public:
+	explicit TimelineSpan(const char *name) {}
+#endif			//OCTOPOCUS_TIMELINE
+};
+
+#endif			//TIMELINE_H_
@@ -0,0 +1,158 @@
+#include "worker_pool.h"
+#include "timeline.h"
+
+#include <assert.h>
+
+class WorkerPool::Worker {
+public:
+	Worker(WorkerPool *_pool, int _self, int _seen) : pool(_pool), self(_self), seen(_seen) {}
+
+	bool Start() { return thread.Start(Entry, this); }
+	void Join() { thread.Join(); }
+
+private:
+	static void Entry(void *argument) {
+		Worker *w = (Worker *)argument;
+		Timeline::NameThread("worker");
+		w->pool->WorkerLoop(w->self, w->seen);
+	}
+
+private:
+	WorkerPool *pool;
+	int self;
+	int seen;
+	NativeThread thread;
+};
+
+WorkerPool::WorkerPool(int thread_count) : queues(0), task(0), size(0), chunk_size(1),
+			start(mutex), done(mutex), generation(0), pending(0), quit(false) {
+	Start(thread_count);
+}
+
+WorkerPool::~WorkerPool() {
+	Stop();
+}
+
+void WorkerPool::SetThreadCount(int thread_count) {
+	Stop();
+	Start(thread_count);
+}
+
+void WorkerPool::Run(Task *t, int s, int c) {
+	if(s <= 0)
+		return;
+	assert(c > 0);
+	int chunk_count = ChunkCount(s, c);
+	//Not worth waking anybody up.
+	if(workers.empty() || chunk_count == 1) {
+		for(int i=0; i<chunk_count; i++) {
+			int end = (i+1)*c;
+			t->Run(i, i*c, end < s ? end : s);
+		}
+		return;
+	}
+
+	{
+		NativeMutexLocker lock(mutex);
+		task = t;
+		size = s;
+		chunk_size = c;
+		int thread_count = GetThreadCount();
+		for(int i=0; i<thread_count; i++) {
+			queues[i].begin = (int)((long long)chunk_count*i/thread_count);
+			queues[i].end = (int)((long long)chunk_count*(i+1)/thread_count);
+		}
+		pending = workers.size();
+		generation++;
+		start.Broadcast();
+	}
+
+	Work(0);
+
+	NativeMutexLocker lock(mutex);
+	while(pending > 0) {
+		done.Wait();
+	}
+	task = 0;
+}
+
+void WorkerPool::Start(int thread_count) {
+	if(thread_count <= 0)
+		thread_count = NativeThread::GetCPUCount();
+	thread_count = thread_count < 1 ? 1 : thread_count;
+
+	quit = false;
+	queues = new Queue[thread_count];
+	for(int i=1; i<thread_count; i++) {
+		Worker *worker = new Worker(this, i, generation);
+		if(!worker->Start()) {
+			//Carry on with fewer threads, the caller of Run alone is enough to get everything done.
+			delete worker;
+			break;
+		}
+		workers.push_back(worker);
+	}
+}
+
+void WorkerPool::Stop() {
+	{
+		NativeMutexLocker lock(mutex);
+		quit = true;
+		start.Broadcast();
+	}
+	for(int i=0; i<workers.size(); i++) {
+		workers[i]->Join();
+		delete workers[i];
+	}
+	workers.clear();
+	delete [] queues;
+	queues = 0;
+}
+
+void WorkerPool::WorkerLoop(int self, int seen) {
+	for(;;) {
+		{
+			NativeMutexLocker lock(mutex);
+			while(generation == seen && !quit) {
+				start.Wait();
+			}
+			if(quit)
+				return;
+			seen = generation;
+		}
+
+		Work(self);
+
+		NativeMutexLocker lock(mutex);
+		if(--pending == 0)
+			done.Signal();
+	}
+}
+
+void WorkerPool::Work(int self) {
+	TimelineSpan span("WorkerPool::Work");
+	int thread_count = GetThreadCount();
+	int chunk;
+	//Own queue first, front to back.
+	while(Take(self, true, &chunk)) {
+		int end = (chunk+1)*chunk_size;
+		task->Run(chunk, chunk*chunk_size, end < size ? end : size);
+	}
+	//Then steal from the back of the others, starting with the next one so that thieves spread out.
+	for(int i=1; i<thread_count; i++) {
+		int victim = (self+i)%thread_count;
+		while(Take(victim, false, &chunk)) {
+			int end = (chunk+1)*chunk_size;
+			task->Run(chunk, chunk*chunk_size, end < size ? end : size);
+		}
+	}
+}
+
+bool WorkerPool::Take(int queue, bool front, int *chunk) {
+	Queue &q = queues[queue];
+	NativeMutexLocker lock(q.lock);
+	if(q.begin >= q.end)
+		return false;
+	*chunk = front ? q.begin++ : --q.end;
+	return true;
+}
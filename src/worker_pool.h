@@ -0,0 +1,80 @@
+#ifndef WORKER_POOL_H_
+#define WORKER_POOL_H_
+
+#include "native_thread.h"
+
+#include <vector>
+
+/**
+ * A fixed set of threads that run data parallel jobs, so that no thread is created per event.
+ *
+ * A job is a range [0, size) cut into chunks of a fixed size. The chunks are dealt out as contiguous runs, one run per
+ * thread, the calling thread being one of them. A thread works on its own run from the front, once it is done it steals
+ * from the back of the others, so an uneven job still keeps every thread busy.
+ *
+ * Which thread runs a chunk is arbitrary, but the chunks themselves only depend on size and chunk_size. A task that
+ * keeps one result per chunk and reduces them in chunk order afterwards gets the same answer for any thread count.
+ *
+ * Threads are the platform's own (@see NativeThread), so the pool and everything it runs build without wxWidgets.
+ */
+class WorkerPool {
+public:
+	class Task {
+	public:
+		virtual ~Task() {}
+		//Chunk number chunk covers [begin, end). Called from any thread, chunks may run at the same time.
+		virtual void Run(int chunk, int begin, int end) = 0;
+	};
+
+private:
+	class Worker;
+
+	//Chunks [begin, end) of one thread not taken yet.
+	struct Queue {
+		NativeMutex lock;
+		int begin, end;
+		char padding[64];		//Keep queues of different threads off the same cache line.
+	};
+
+public:
+	//thread_count includes the calling thread, 0 for one per cpu.
+	explicit WorkerPool(int thread_count = 0);
+	~WorkerPool();
+
+	void SetThreadCount(int thread_count);
+	int GetThreadCount() const { return workers.size()+1; }
+
+	//Number of chunks Run cuts size into.
+	static int ChunkCount(int size, int chunk_size) { return (size+chunk_size-1)/chunk_size; }
+
+	/**
+	 * Run task over [0, size) and return once every chunk is done.
+	 * Only one job at a time, task must not call Run itself.
+	 */
+	void Run(Task *task, int size, int chunk_size);
+
+private:
+	void Start(int thread_count);
+	void Stop();
+	//Called by each thread with its own number, 0 being the caller of Run.
+	void Work(int self);
+	//seen is the job generation when the worker was created.
+	void WorkerLoop(int self, int seen);
+	bool Take(int queue, bool front, int *chunk);
+
+private:
+	std::vector<Worker *> workers;
+	Queue *queues;			//One per thread.
+
+	//Job description, set under mutex before the workers are woken up.
+	Task *task;
+	int size, chunk_size;
+
+	NativeMutex mutex;
+	NativeCondition start, done;
+	int generation;		//Bumped for every job, workers wait for a new one.
+	int pending;		//Workers still busy with the current job.
+	bool quit;
+};
+
+#endif			//WORKER_POOL_H_